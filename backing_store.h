@@ -0,0 +1,568 @@
+/**
+ * Header file for the BackingStore class that performs real file I/O for the
+ * simulated disks. Every Disk is mapped to its own directory on the host and a
+ * 'd' request reads or writes the named file inside that directory.
+ *
+ * Requests are submitted through io_uring when the kernel supports it, otherwise
+ * a small pool of worker threads performs the I/O with pread/pwrite.
+ */
+
+#ifndef BACKING_STORE_H
+#define BACKING_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Struct that holds the result of a single finished backing-file request.
+ */
+struct IoCompletion {
+    long request_id_;
+    int disk_;
+    long bytes_;
+    int error_;
+
+    IoCompletion() : request_id_{0}, disk_{0}, bytes_{0}, error_{0}
+        { }
+};
+
+/**
+ * Struct that holds the measured I/O statistics for a single disk.
+ */
+struct DiskIoStats {
+    long reads_;
+    long writes_;
+    long errors_;
+    long bytes_read_;
+    long bytes_written_;
+    double total_latency_us_;
+    double max_latency_us_;
+    chrono::steady_clock::time_point first_submit_;
+    chrono::steady_clock::time_point last_complete_;
+
+    DiskIoStats() :
+        reads_{0}, writes_{0}, errors_{0}, bytes_read_{0}, bytes_written_{0},
+        total_latency_us_{0}, max_latency_us_{0}
+        { }
+
+    long requests() const {
+        return reads_ + writes_;
+    }
+
+    /**
+     * Average latency of a request in microseconds.
+     */
+    double averageLatency() const {
+        return requests() > 0 ? total_latency_us_ / requests() : 0;
+    }
+
+    /**
+     * Throughput in MB/s measured from the first submission to the last
+     * completion on this disk.
+     */
+    double throughput() const {
+        if (requests() == 0) { return 0; }
+
+        double seconds = chrono::duration<double>(last_complete_ - first_submit_).count();
+        if (seconds <= 0) { return 0; }
+
+        return (bytes_read_ + bytes_written_) / seconds / 1000000.0;
+    }
+};
+
+/**
+ * Minimal io_uring wrapper built directly on the kernel interface so that the
+ * simulator does not need liburing. Only the operations that the BackingStore
+ * uses (read, write and non-blocking reaping) are exposed.
+ */
+class IoUring {
+    public:
+        IoUring() :
+            ring_fd_{-1}, entries_{0}, sq_ptr_{nullptr}, cq_ptr_{nullptr},
+            sqes_{nullptr}, sq_size_{0}, cq_size_{0}, sqes_size_{0}
+            { }
+
+        ~IoUring() {
+            if (sqes_ != nullptr) { munmap(sqes_, sqes_size_); }
+            if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) { munmap(cq_ptr_, cq_size_); }
+            if (sq_ptr_ != nullptr) { munmap(sq_ptr_, sq_size_); }
+            if (ring_fd_ >= 0) { close(ring_fd_); }
+        }
+
+        /**
+         * @entries: the depth of the submission queue.
+         *
+         * Sets up the ring and maps the submission and completion queues.
+         * Returns false if io_uring is not available on this kernel.
+         */
+        bool init(unsigned entries) {
+            struct io_uring_params params;
+            memset(&params, 0, sizeof(params));
+
+            ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+            if (ring_fd_ < 0) { return false; }
+
+            sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                if (cq_size_ > sq_size_) { sq_size_ = cq_size_; }
+                cq_size_ = sq_size_;
+            }
+
+            sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED) { sq_ptr_ = nullptr; return false; }
+
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                cq_ptr_ = sq_ptr_;
+            } else {
+                cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+                if (cq_ptr_ == MAP_FAILED) { cq_ptr_ = nullptr; return false; }
+            }
+
+            sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+            void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) { return false; }
+            sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+            char* sq = static_cast<char*>(sq_ptr_);
+            char* cq = static_cast<char*>(cq_ptr_);
+            sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+            entries_ = params.sq_entries;
+
+            return true;
+        }
+
+        /**
+         * @fd: file to operate on.
+         * @write: true for a write, false for a read.
+         * @buffer: data buffer, must stay alive until the completion is reaped.
+         * @length: number of bytes.
+         * @user_data: value handed back with the completion.
+         *
+         * Places a single request on the submission queue and tells the kernel
+         * about it. Returns false, without queuing anything, if the submission
+         * queue is full. A request the kernel did not take yet stays queued and
+         * is submitted with the next one or by wait().
+         */
+        bool submit(int fd, bool write, char* buffer, unsigned length, unsigned long long user_data) {
+            unsigned tail = *sq_tail_;
+            if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= entries_) { return false; }
+
+            unsigned index = tail & *sq_mask_;
+            struct io_uring_sqe* sqe = &sqes_[index];
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<unsigned long long>(buffer);
+            sqe->len = length;
+            sqe->off = 0;
+            sqe->user_data = user_data;
+
+            sq_array_[index] = index;
+            __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+            syscall(__NR_io_uring_enter, ring_fd_, unsubmitted(), 0, 0, nullptr, 0);
+            return true;
+        }
+
+        /**
+         * Submits the requests still queued and blocks until at least one
+         * completion can be reaped. Returns false if the kernel refused.
+         */
+        bool wait() {
+            long result = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted(), 1,
+                                  IORING_ENTER_GETEVENTS, nullptr, 0);
+
+            return result >= 0 || errno == EINTR;
+        }
+
+        /**
+         * @user_data: set to the user data of the reaped request.
+         * @result: set to the return value of the request.
+         *
+         * Reaps one completion without blocking. Returns false when the
+         * completion queue is empty.
+         */
+        bool reap(unsigned long long& user_data, int& result) {
+            unsigned head = *cq_head_;
+
+            if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) { return false; }
+
+            struct io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+            user_data = cqe->user_data;
+            result = cqe->res;
+
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+    private:
+        int ring_fd_;
+        unsigned entries_;
+        void* sq_ptr_;
+        void* cq_ptr_;
+        struct io_uring_sqe* sqes_;
+        size_t sq_size_;
+        size_t cq_size_;
+        size_t sqes_size_;
+        unsigned* sq_head_;
+        unsigned* sq_tail_;
+        unsigned* sq_mask_;
+        unsigned* sq_array_;
+        unsigned* cq_head_;
+        unsigned* cq_tail_;
+        unsigned* cq_mask_;
+        struct io_uring_cqe* cqes_;
+
+        unsigned unsubmitted() const {
+            return *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        }
+};
+
+/**
+ * Class that maps every simulated Disk to a directory and performs the
+ * requested file I/O asynchronously.
+ */
+class BackingStore {
+    public:
+        /**
+         * @root: directory that will hold one sub directory per disk.
+         * @disk_count: number of disks of the OS.
+         * @io_size: number of bytes read or written by each request, at least 1.
+         * @workers: number of threads used when io_uring is unavailable.
+         *
+         * Creates the disk directories and sets up io_uring. If the ring can't
+         * be created the worker threads are started instead.
+         */
+        BackingStore(string root, int disk_count, long io_size, int workers) :
+            root_{root}, io_size_{io_size}, stopping_{false}, stats_(disk_count)
+            {
+                mkdir(root_.c_str(), 0755);
+                for (int i = 0; i < disk_count; i++) {
+                    mkdir(diskDirectory(i).c_str(), 0755);
+                }
+
+                if (!ring_.init(kRingEntries)) {
+                    use_ring_ = false;
+                    for (int i = 0; i < workers; i++) {
+                        workers_.push_back(thread(&BackingStore::workerLoop, this));
+                    }
+                } else {
+                    use_ring_ = true;
+                }
+            }
+
+        /**
+         * Stops the worker threads, waits for the requests still in the ring
+         * (the kernel reads into and writes from their buffers until they
+         * complete) and closes every file that is still open.
+         */
+        ~BackingStore() {
+            {
+                lock_guard<mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            work_ready_.notify_all();
+
+            for (auto &worker : workers_) {
+                worker.join();
+            }
+
+            if (use_ring_) {
+                lock_guard<mutex> lock(mutex_);
+                unsigned long long user_data;
+                int result;
+
+                while (!in_flight_.empty()) {
+                    if (!ring_.reap(user_data, result)) {
+                        if (!ring_.wait()) { break; }
+                        continue;
+                    }
+
+                    map<long, PendingIo>::iterator itr = in_flight_.find(user_data);
+                    if (itr == in_flight_.end()) { continue; }
+
+                    close(itr->second.fd_);
+                    in_flight_.erase(itr);
+                }
+            }
+
+            for (auto &pending : in_flight_) {
+                close(pending.second.fd_);
+            }
+        }
+
+        /**
+         * Returns true if requests go through io_uring.
+         */
+        bool usingIoUring() {
+            return use_ring_;
+        }
+
+        /**
+         * Returns the directory that holds all the disk directories.
+         */
+        string getRoot() {
+            return root_;
+        }
+
+        /**
+         * @request_id: id of the disk entry the request belongs to.
+         * @disk: the disk the file lives on.
+         * @filename: name of the file inside the disk directory.
+         * @write: true if the file is written, false if it is read.
+         *
+         * Opens the file and hands the request to io_uring or to the worker
+         * threads. If the file can't be opened, its name is not a plain name
+         * inside the disk directory (see validFilename(...)) or the ring
+         * already holds kRingEntries requests, the failure is reported as an
+         * immediate completion so the disk queue keeps moving.
+         */
+        void submit(long request_id, int disk, string filename, bool write) {
+            PendingIo pending;
+            pending.request_id_ = request_id;
+            pending.disk_ = disk;
+            pending.write_ = write;
+            pending.submitted_ = chrono::steady_clock::now();
+            pending.fd_ = -1;
+            int error = EINVAL;
+
+            if (validFilename(filename)) {
+                string path = diskDirectory(disk) + "/" + filename;
+                int flags = write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+
+                pending.fd_ = open(path.c_str(), flags, 0644);
+                error = errno;
+            }
+
+            lock_guard<mutex> lock(mutex_);
+
+            if (stats_[disk].requests() == 0 && stats_[disk].errors_ == 0) {
+                stats_[disk].first_submit_ = pending.submitted_;
+            }
+
+            if (pending.fd_ < 0) {
+                finished_.push_back(complete(pending, -error));
+                return;
+            }
+
+            if (use_ring_ && in_flight_.size() >= kRingEntries) {
+                close(pending.fd_);
+                finished_.push_back(complete(pending, -EAGAIN));
+                return;
+            }
+
+            pending.buffer_.assign(io_size_, write ? 'x' : 0);
+            in_flight_[request_id] = pending;
+            PendingIo &stored = in_flight_[request_id];
+
+            if (use_ring_) {
+                if (!ring_.submit(stored.fd_, write, stored.buffer_.data(), io_size_, request_id)) {
+                    close(stored.fd_);
+                    finished_.push_back(complete(stored, -EAGAIN));
+                    in_flight_.erase(request_id);
+                }
+            } else {
+                work_queue_.push_back(request_id);
+                work_ready_.notify_one();
+            }
+        }
+
+        /**
+         * @completion: filled with the next finished request.
+         *
+         * Returns false if no request has finished since the last call.
+         * Never blocks.
+         */
+        bool pollCompletion(IoCompletion& completion) {
+            lock_guard<mutex> lock(mutex_);
+
+            if (use_ring_) {
+                unsigned long long user_data;
+                int result;
+
+                while (ring_.reap(user_data, result)) {
+                    map<long, PendingIo>::iterator itr = in_flight_.find(user_data);
+                    if (itr == in_flight_.end()) { continue; }
+
+                    close(itr->second.fd_);
+                    finished_.push_back(complete(itr->second, result));
+                    in_flight_.erase(itr);
+                }
+            }
+
+            if (finished_.empty()) { return false; }
+
+            completion = finished_.front();
+            finished_.pop_front();
+            return true;
+        }
+
+        /**
+         * @disk: the disk whose statistics are returned.
+         */
+        DiskIoStats getStats(int disk) {
+            lock_guard<mutex> lock(mutex_);
+            return stats_[disk];
+        }
+
+    private:
+        /**
+         * Struct that holds everything a request needs while it is in flight.
+         */
+        struct PendingIo {
+            long request_id_;
+            int disk_;
+            int fd_;
+            bool write_;
+            vector<char> buffer_;
+            chrono::steady_clock::time_point submitted_;
+        };
+
+        static const unsigned kRingEntries = 64;
+
+        /**
+         * @root_: directory holding the disk directories.
+         * @io_size_: bytes per request.
+         * @use_ring_: true if io_uring is used, false if the workers are.
+         * @stopping_: tells the worker threads to exit.
+         * @ring_: the io_uring instance.
+         * @mutex_: protects every member below.
+         * @work_ready_: wakes up the worker threads.
+         * @in_flight_: requests that were submitted but are not finished. With
+         * io_uring there are at most kRingEntries, so the ring never overflows.
+         * @work_queue_: requests waiting for a worker thread.
+         * @finished_: completions that have not been polled yet.
+         * @stats_: the measured statistics of every disk.
+         * @workers_: the fallback worker threads.
+         */
+        string root_;
+        long io_size_;
+        bool use_ring_;
+        bool stopping_;
+        IoUring ring_;
+        mutex mutex_;
+        condition_variable work_ready_;
+        map<long, PendingIo> in_flight_;
+        deque<long> work_queue_;
+        deque<IoCompletion> finished_;
+        vector<DiskIoStats> stats_;
+        vector<thread> workers_;
+
+        string diskDirectory(int disk) {
+            return root_ + "/disk" + to_string(disk);
+        }
+
+        /**
+         * @filename: the name given with 'd'.
+         *
+         * Returns false for names that could leave the disk directory: empty
+         * names, "." and "..", and names with a '/'.
+         */
+        static bool validFilename(const string& filename) {
+            return !filename.empty() && filename != "." && filename != ".." &&
+                   filename.find('/') == string::npos;
+        }
+
+        /**
+         * @pending: the request that finished.
+         * @result: number of bytes transferred or a negative errno.
+         *
+         * Records the latency of the request and builds its completion.
+         * Caller must hold @mutex_.
+         */
+        IoCompletion complete(PendingIo& pending, int result) {
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            double latency = chrono::duration<double, micro>(now - pending.submitted_).count();
+            DiskIoStats &stats = stats_[pending.disk_];
+
+            IoCompletion completion;
+            completion.request_id_ = pending.request_id_;
+            completion.disk_ = pending.disk_;
+
+            if (result < 0) {
+                stats.errors_++;
+                completion.error_ = -result;
+                return completion;
+            }
+
+            if (pending.write_) {
+                stats.writes_++;
+                stats.bytes_written_ += result;
+            } else {
+                stats.reads_++;
+                stats.bytes_read_ += result;
+            }
+
+            stats.total_latency_us_ += latency;
+            if (latency > stats.max_latency_us_) { stats.max_latency_us_ = latency; }
+            stats.last_complete_ = now;
+
+            completion.bytes_ = result;
+            return completion;
+        }
+
+        /**
+         * Loop run by each worker thread when io_uring is not available.
+         * Takes a request from @work_queue_, performs it without holding the
+         * lock and then publishes the completion.
+         */
+        void workerLoop() {
+            unique_lock<mutex> lock(mutex_);
+
+            while (true) {
+                work_ready_.wait(lock, [this] { return stopping_ || !work_queue_.empty(); });
+                if (stopping_) { return; }
+
+                long request_id = work_queue_.front();
+                work_queue_.pop_front();
+
+                map<long, PendingIo>::iterator itr = in_flight_.find(request_id);
+                if (itr == in_flight_.end()) { continue; }
+
+                int fd = itr->second.fd_;
+                bool write = itr->second.write_;
+                char* buffer = itr->second.buffer_.data();
+
+                lock.unlock();
+                ssize_t result = write ? pwrite(fd, buffer, io_size_, 0) : pread(fd, buffer, io_size_, 0);
+                int error = errno;
+                close(fd);
+                lock.lock();
+
+                finished_.push_back(complete(itr->second, result < 0 ? -error : result));
+                in_flight_.erase(itr);
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,303 @@
+/**
+ * Header file for the BufferCache class that sits in front of the disks. It
+ * keeps the blocks that were recently read or written, keyed by the disk and
+ * the filename, so a read of a cached block does not have to queue on the disk.
+ */
+
+#ifndef BUFFER_CACHE_H
+#define BUFFER_CACHE_H
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Which block is evicted when the cache is full. LRU evicts the least recently
+ * used block. 2Q keeps blocks used once in a small FIFO queue and only promotes
+ * a block to the LRU queue when it is used again after leaving the FIFO, so a
+ * scan of many files used once cannot flush the blocks that are used often.
+ */
+enum CachePolicy {
+    CACHE_LRU,
+    CACHE_2Q
+};
+
+/**
+ * Struct that holds the counters of one disk.
+ *
+ * @hits_: reads that found their block in the cache.
+ * @misses_: reads that had to queue on the disk.
+ * @writes_: writes, which always go to the disk and leave the block cached.
+ */
+struct CacheStats {
+    long hits_;
+    long misses_;
+    long writes_;
+
+    CacheStats() : hits_{0}, misses_{0}, writes_{0}
+        { }
+
+    double hitRatio() const {
+        return hits_ + misses_ > 0 ? (double) hits_ / (hits_ + misses_) : 0;
+    }
+
+    /**
+     * @sojourn: average time a request spends queued on and using the disk.
+     * @elapsed: ticks since the disk was created.
+     *
+     * Returns how much deeper the disk queue would have been on average if
+     * the hits had queued as well (Little's law: every hit would have spent
+     * @sojourn ticks in the queue).
+     */
+    double depthSaved(double sojourn, long elapsed) const {
+        return elapsed > 0 ? hits_ * sojourn / elapsed : 0;
+    }
+};
+
+/**
+ * Class that simulates the buffer cache shared by all the disks. Every
+ * operation is O(1): the blocks are kept in lists and found through a hash
+ * table that holds the position of every block in its list.
+ *
+ * The cache is not thread safe, the OperatingSystem only uses it while holding
+ * its scheduler lock.
+ */
+class BufferCache {
+    public:
+        /**
+         * The cache starts disabled, see configure().
+         */
+        BufferCache() : capacity_{0}, policy_{CACHE_LRU}, in_limit_{0}, ghost_limit_{0}
+            { }
+
+        /**
+         * @other: the cache that is copied. The lists are copied and the hash
+         * table is rebuilt to point into the new lists.
+         */
+        BufferCache(const BufferCache& other) :
+            capacity_{other.capacity_}, policy_{other.policy_}, in_limit_{other.in_limit_},
+            ghost_limit_{other.ghost_limit_}, in_{other.in_}, main_{other.main_},
+            ghost_{other.ghost_}, stats_{other.stats_}
+            {
+                indexList(in_, QUEUE_IN);
+                indexList(main_, QUEUE_MAIN);
+                indexList(ghost_, QUEUE_GHOST);
+            }
+
+        BufferCache& operator=(const BufferCache&) = delete;
+
+        /**
+         * @capacity: the most blocks the cache holds, 0 to disable it.
+         * @policy: LRU or 2Q.
+         *
+         * Empties the cache and its counters. With 2Q a quarter of @capacity is used for the FIFO
+         * of new blocks and the keys of half of @capacity evicted blocks are
+         * remembered.
+         */
+        void configure(int capacity, CachePolicy policy) {
+            capacity_ = capacity < 0 ? 0 : capacity;
+            policy_ = policy;
+            in_limit_ = capacity_ / 4 > 0 ? capacity_ / 4 : 1;
+            ghost_limit_ = capacity_ / 2 > 0 ? capacity_ / 2 : 1;
+
+            blocks_.clear();
+            in_.clear();
+            main_.clear();
+            ghost_.clear();
+            stats_.clear();
+        }
+
+        bool enabled() const {
+            return capacity_ > 0;
+        }
+
+        int capacity() const {
+            return capacity_;
+        }
+
+        CachePolicy policy() const {
+            return policy_;
+        }
+
+        /**
+         * Returns the number of blocks held, not counting the keys 2Q remembers.
+         */
+        int size() const {
+            return in_.size() + main_.size();
+        }
+
+        /**
+         * @disk: the disk the block is read from.
+         * @filename: the block.
+         *
+         * Returns true if the block is cached. Otherwise the block is read
+         * into the cache, evicting another one if the cache is full.
+         */
+        bool read(int disk, const string& filename) {
+            bool hit = reference(CacheKey{disk, filename});
+
+            if (hit) {
+                statsOf(disk).hits_++;
+            } else {
+                statsOf(disk).misses_++;
+            }
+            return hit;
+        }
+
+        /**
+         * @disk: the disk the block is written to.
+         * @filename: the block.
+         *
+         * The cache writes through: the write still queues on the disk, but
+         * the block is cached so the next read of it is a hit.
+         */
+        void write(int disk, const string& filename) {
+            reference(CacheKey{disk, filename});
+            statsOf(disk).writes_++;
+        }
+
+        /**
+         * @disk_count: the number of disks and disk groups.
+         *
+         * Returns the counters of every disk, in order.
+         */
+        vector<CacheStats> snapshot(int disk_count) const {
+            vector<CacheStats> stats(stats_.begin(), stats_.end());
+
+            stats.resize(disk_count);
+            return stats;
+        }
+
+    private:
+        /**
+         * The list a block is in. Blocks in QUEUE_GHOST are not cached, only
+         * their key is remembered.
+         */
+        enum BlockQueue {
+            QUEUE_IN,
+            QUEUE_MAIN,
+            QUEUE_GHOST
+        };
+
+        struct CacheKey {
+            int disk_;
+            string filename_;
+
+            bool operator==(const CacheKey& other) const {
+                return disk_ == other.disk_ && filename_ == other.filename_;
+            }
+        };
+
+        struct CacheKeyHash {
+            size_t operator()(const CacheKey& key) const {
+                return hash<string>()(key.filename_) * 31 + key.disk_;
+            }
+        };
+
+        /**
+         * @queue_: the list holding the block.
+         * @position_: where the block is in that list.
+         */
+        struct Block {
+            BlockQueue queue_;
+            list<CacheKey>::iterator position_;
+        };
+
+        /**
+         * @capacity_: the most blocks the cache holds, 0 if it is disabled.
+         * @policy_: LRU or 2Q.
+         * @in_limit_: the most blocks of the 2Q FIFO.
+         * @ghost_limit_: the most evicted keys 2Q remembers.
+         * @blocks_: every cached block and remembered key.
+         * @in_: the 2Q FIFO of blocks used once, newest first.
+         * @main_: the LRU list, most recently used first.
+         * @ghost_: keys of the blocks 2Q evicted from @in_, newest first.
+         * @stats_: the counters of every disk, by disk number.
+         */
+        int capacity_;
+        CachePolicy policy_;
+        int in_limit_;
+        int ghost_limit_;
+        unordered_map<CacheKey, Block, CacheKeyHash> blocks_;
+        list<CacheKey> in_;
+        list<CacheKey> main_;
+        list<CacheKey> ghost_;
+        vector<CacheStats> stats_;
+
+        void indexList(list<CacheKey>& keys, BlockQueue queue) {
+            for (list<CacheKey>::iterator itr = keys.begin(); itr != keys.end(); ++itr) {
+                blocks_[*itr] = Block{queue, itr};
+            }
+        }
+
+        CacheStats& statsOf(int disk) {
+            if (disk >= (int) stats_.size()) {
+                stats_.resize(disk + 1);
+            }
+            return stats_[disk];
+        }
+
+        /**
+         * @key: the block that is used.
+         *
+         * Returns true if the block was cached. A block in the LRU list moves
+         * to its front, a block in the 2Q FIFO stays where it is. A block that
+         * was not cached is inserted: into the LRU list with LRU or if 2Q
+         * remembers it, otherwise into the FIFO.
+         */
+        bool reference(const CacheKey& key) {
+            unordered_map<CacheKey, Block, CacheKeyHash>::iterator itr = blocks_.find(key);
+
+            if (itr != blocks_.end() && itr->second.queue_ == QUEUE_MAIN) {
+                main_.splice(main_.begin(), main_, itr->second.position_);
+                return true;
+            } else if (itr != blocks_.end() && itr->second.queue_ == QUEUE_IN) {
+                return true;
+            }
+
+            bool remembered = itr != blocks_.end();
+            if (remembered) {
+                ghost_.erase(itr->second.position_);
+                blocks_.erase(itr);
+            }
+
+            if (policy_ == CACHE_LRU || remembered) {
+                main_.push_front(key);
+                blocks_[key] = Block{QUEUE_MAIN, main_.begin()};
+            } else {
+                in_.push_front(key);
+                blocks_[key] = Block{QUEUE_IN, in_.begin()};
+            }
+
+            reclaim();
+            return false;
+        }
+
+        /**
+         * Evicts blocks until at most @capacity_ are cached. 2Q evicts from the
+         * FIFO while it is over @in_limit_ and remembers the key of the block,
+         * otherwise the least recently used block is evicted.
+         */
+        void reclaim() {
+            while (size() > capacity_) {
+                if (!in_.empty() && ((int) in_.size() > in_limit_ || main_.empty())) {
+                    ghost_.splice(ghost_.begin(), in_, --in_.end());
+                    blocks_[ghost_.front()] = Block{QUEUE_GHOST, ghost_.begin()};
+
+                    if ((int) ghost_.size() > ghost_limit_) {
+                        blocks_.erase(ghost_.back());
+                        ghost_.pop_back();
+                    }
+                } else {
+                    blocks_.erase(main_.back());
+                    main_.pop_back();
+                }
+            }
+        }
+};
+
+#endif
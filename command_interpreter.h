@@ -0,0 +1,714 @@
+/**
+ * Header file for the CommandInterpreter class that turns a line of the
+ * simulator's command language into calls on the OperatingSystem. Used by
+ * both the interactive prompt and the server mode.
+ *
+ * The OperatingSystem returns status codes and snapshot structs, this is the
+ * only place they are turned into text.
+ */
+
+#ifndef COMMAND_INTERPRETER_H
+#define COMMAND_INTERPRETER_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "helpers.h"
+#include "operating_system.h"
+#include "output_buffer.h"
+
+using namespace std;
+
+/**
+ * The result of running a single command.
+ */
+enum CommandStatus {
+    COMMAND_OK,
+    COMMAND_FAILED,
+    COMMAND_INVALID,
+    COMMAND_SHUTDOWN
+};
+
+/**
+ * Works with any BasicOperatingSystem (see operating_system.h).
+ */
+template <class OS>
+class CommandInterpreter {
+    public:
+        /**
+         * @os: the operating system every command is run against.
+         */
+        CommandInterpreter(OS& os) : os_(os), out_(cout)
+            { }
+
+        /**
+         * @os: the operating system every command is run against.
+         * @out: the stream the output of the commands is written to.
+         */
+        CommandInterpreter(OS& os, ostream& out) : os_(os), out_(out)
+            { }
+
+        /**
+         * @user_input: one line of input.
+         *
+         * If the first piece of the input matches a particular criteria that needs a
+         * number i.e m <num> we take the second value place it into a stringstream
+         * and then push that stringstream into an integer value. If the command receives
+         * something that is not wanted the command is invalid and the user is informed.
+         *
+         * Empty lines are ignored. Every other command advances the simulated
+         * clock by one tick, 't <n>' by <n> ticks in all. Returns COMMAND_SHUTDOWN
+         * for 'bsod' and COMMAND_FAILED if the OS refused the command.
+         */
+        CommandStatus execute(string user_input) {
+            string first, second, third;
+            stringstream s(user_input), stream;
+            s >> first;
+
+            if (first.empty()) {
+                return COMMAND_OK;
+            } else if (first == "bsod") {
+                return COMMAND_SHUTDOWN;
+            }
+
+            if (first == "t") {
+                s >> second;
+
+                if (isNumber(second) && !second.empty()) {
+                    stream << second;
+                    long ticks;
+
+                    stream >> ticks;
+
+                    return report(os_.submit(OsRequest(OP_TICK, ticks > 0 ? ticks : 1)), 0);
+                }
+
+                os_.advanceClock();
+                return invalid();
+            }
+
+            os_.advanceClock();
+
+            if (first == "help") {
+                help();
+            } else if (first == "A") {
+                return report(os_.spawnProcess(), 0);
+            } else if (first == "Q") {
+                return report(os_.preemptProcess(), 0);
+            } else if (first == "fork") {
+                return report(os_.forkProcess(), 0);
+            } else if (first == "exit") {
+                return report(os_.exitProcess(), 0);
+            } else if (first == "wait") {
+                return report(os_.waitProcess(), 0);
+            } else if (first == "S") {
+                s >> second;
+                if (second == "i") {
+                    s >> third;
+
+                    if (third == "json") {
+                        showIOJson(os_.snapshotIO());
+                    } else {
+                        showIO(os_.snapshotIO());
+                    }
+                } else if (second == "m") {
+                    s >> third;
+                    showMemory(os_.snapshotMemory(third == "+"));
+                } else if (second == "r") {
+                    showCPU(os_.snapshotCPU());
+                } else if (second == "s") {
+                    showSwap(os_.snapshotSwap());
+                } else if (second == "n") {
+                    showNodes(os_.snapshotNodes());
+                } else if (second == "q") {
+                    showQuotas(os_.snapshotQuotas());
+                } else {
+                    return invalid();
+                }
+            } else if (first == "d") {
+                s >> second;
+
+                if (isNumber(second) && !second.empty()) {
+                    stream << second;
+                    int disk_num;
+
+                    stream >> disk_num;
+                    s >> third;
+
+                    string mode;
+                    s >> mode;
+
+                    return report(os_.useDisk(disk_num, third, mode == "w"), disk_num);
+                } else {
+                    return invalid();
+                }
+            } else if (first == "D") {
+                s >> second;
+
+                if (isNumber(second) && !second.empty()) {
+                    stream << second;
+                    int disk_num;
+
+                    stream >> disk_num;
+
+                    return report(os_.finishDiskUsage(disk_num), disk_num);
+                } else {
+                    return invalid();
+                }
+            } else if (first == "P") {
+                s >> second;
+
+                if (isNumber(second) && !second.empty()) {
+                    stream << second;
+                    int priority;
+
+                    stream >> priority;
+
+                    return report(os_.setPriority(priority), 0);
+                } else {
+                    return invalid();
+                }
+            } else if (first == "m" || first == "w") {
+                s >> second;
+
+                if (isNumber(second) && !second.empty()) {
+                    stream << second;
+                    int mem_address;
+
+                    stream >> mem_address;
+
+                    return report(os_.useMemory(mem_address, first == "w"), 0);
+                } else {
+                    return invalid();
+                }
+            } else {
+                return invalid();
+            }
+
+            return COMMAND_OK;
+        }
+
+        /**
+         * Function that is called whenever the user needs help on
+         * how to use the OS.
+         */
+        void help() {
+            out_ << "\n=================================HELP================================" << endl;
+            out_ << "'A' to generate process" << endl;
+            out_ << "'Q' to preempt current running process" << endl;
+            out_ << "'fork' to generate child process for current running proc" << endl;
+            out_ << "'exit' to end execution of current running process" << endl;
+            out_ << "'wait' to pause execution for current running process" << endl;
+            out_ << "'d <disk_num> <filename>' to have current proc use disk<disk_num>" << endl;
+            out_ << "'d <disk_num> <filename> w' to have current proc write to disk<disk_num>" << endl;
+            out_ << "'D <disk_num>' to finish work on disk <disk_num>" << endl;
+            out_ << "'m <address>' to have current process use memory at <address>" << endl;
+            out_ << "'w <address>' to have current process write memory at <address>" << endl;
+            out_ << "'P <priority>' to set the priority of the current process" << endl;
+            out_ << "'t <n>' to advance the clock by <n> ticks" << endl;
+            out_ << "'S r' to display a snapshot of the ready queue" << endl;
+            out_ << "'S i' to display a snapshot of the disks" << endl;
+            out_ << "'S i json' to dump the disk statistics as JSON" << endl;
+            out_ << "'S m' to display a snapshow of the memory table" << endl;
+            out_ << "'S m +' to display the frames changed since the last memory snapshot" << endl;
+            out_ << "'S s' to display the page fault and swap statistics" << endl;
+            out_ << "'S n' to display the NUMA node statistics" << endl;
+            out_ << "'S q' to display the frame quota and fault rate of every process" << endl;
+            out_ << "'help' to display this message agains" << endl;
+            out_ << "'bsod' to end the simulation" << endl;
+            out_ << "=====================================================================\n" << endl;
+        }
+
+    private:
+        /**
+         * @os_: the operating system commands are run against.
+         * @out_: the stream the output is written to.
+         */
+        OS& os_;
+        ostream& out_;
+
+        CommandStatus invalid() {
+            out_ << "Invalid command" << endl;
+            return COMMAND_INVALID;
+        }
+
+        /**
+         * @status: what the OS returned.
+         * @disk_number: the disk of the command, for the disk errors.
+         *
+         * Tells the user why the command failed, if it did.
+         */
+        CommandStatus report(OsStatus status, int disk_number) {
+            switch (status) {
+                case OS_OK:
+                    return COMMAND_OK;
+                case OS_CPU_IDLE:
+                    out_ << "COMMAND FAILED: CPU IS IDLE" << endl;
+                    out_ << "Enter Different Command\n" << endl;
+                    break;
+                case OS_NO_CHILDREN:
+                    out_ << "COMMAND FAILED: Process " << os_.runningProcess() << " HAS NO CHILDREN" << endl;
+                    out_ << "Enter Different Command\n" << endl;
+                    break;
+                case OS_PIDS_EXHAUSTED:
+                    out_ << "COMMAND FAILED: ALL " << os_.maxPid() - 1 << " PIDS ARE IN USE" << endl;
+                    out_ << "Enter Different Command\n" << endl;
+                    break;
+                case OS_NO_SUCH_DISK:
+                    out_ << "ERROR: Disk " << disk_number << " does not exist" << endl;
+                    out_ << endl;
+                    break;
+                case OS_DISK_IS_GROUP:
+                    out_ << "ERROR: Disk " << disk_number << " is a disk group, finish its member disks" << endl;
+                    out_ << endl;
+                    break;
+                case OS_DISK_IDLE:
+                    out_ << "ERROR: Disk " << disk_number << " is idle" << endl;
+                    out_ << endl;
+                    break;
+                default:
+                    out_ << "ERROR: Invalid request" << endl;
+                    out_ << endl;
+                    break;
+            }
+
+            return COMMAND_FAILED;
+        }
+
+        /**
+         * Displays the currently running process along with all processes
+         * waiting in the ready queue and those waiting for a child. The rows go
+         * through an OutputBuffer (see output_buffer.h) so a queue of millions
+         * of processes is printed without a flush per row.
+         */
+        void showCPU(const CpuSnapshot& cpu) {
+            OutputBuffer out(out_);
+
+            if (cpu.running_ == 0) {
+                out.append("CPU: IDLE");
+                out.newline();
+            } else {
+                out.append("CPU: Process ");
+                out.appendLeft(cpu.running_, 0);
+                out.newline();
+
+                if (cpu.quantum_ > 0) {
+                    out.append("Time slice: ");
+                    out.appendLeft(cpu.slice_used_, 0);
+                    out.append("/");
+                    out.appendLeft(cpu.quantum_, 0);
+                    out.append(cpu.quantum_unit_ == QUANTUM_TICKS ? " ticks used, " : " references used, ");
+                    out.appendLeft(cpu.slices_expired_, 0);
+                    out.append(" slices expired");
+                    out.newline();
+                }
+
+                if (cpu.ready_.empty()) {
+                    out.append("Ready Queue: EMPTY");
+                    out.newline();
+                } else {
+                    out.append("Ready-Queue: ");
+                    out.newline();
+
+                    for (auto &pid : cpu.ready_) {
+                        out.append("\t    Process ");
+                        out.appendLeft(pid, 0);
+                        out.newline();
+                    }
+                }
+            }
+
+            if (!cpu.waiting_.empty()) {
+                out.append("Waiting-for-child:");
+                out.newline();
+                for (auto &pid : cpu.waiting_) {
+                    out.append("\t    Process ");
+                    out.appendLeft(pid, 0);
+                    out.newline();
+                }
+            }
+
+            out.newline();
+            out.flush();
+            out_.flush();
+        }
+
+        /**
+         * Prints a row for every frame of the snapshot, frames that were freed
+         * are shown with '-'.
+         */
+        void showMemory(const vector<FrameRow>& rows) {
+            OutputBuffer out(out_);
+
+            out.appendLeft("Frame#", 10);
+            out.appendLeft("Page#", 10);
+            out.appendLeft("PID", 7);
+            out.appendLeft("Timestamp", 10);
+            out.newline();
+            out.appendFill('=', 37);
+            out.newline();
+
+            for (auto &row : rows) {
+                out.append("  ");
+                out.appendLeft(row.frame_, 9);
+
+                if (row.active_) {
+                    out.appendLeft(row.page_, 10);
+                    out.appendLeft(row.pid_, 6);
+                    out.appendRight(row.timestamp_, 5);
+                } else {
+                    out.appendLeft("-", 10);
+                    out.appendLeft("-", 6);
+                    out.appendFill(' ', 4);
+                    out.append("-");
+                }
+                out.newline();
+            }
+
+            out.newline();
+        }
+
+        /**
+         * Prints the page fault, prefetch and write-back counters and the
+         * state of the swap area.
+         */
+        void showSwap(const SwapSnapshot& swap) {
+            long faults = swap.minor_faults_ + swap.major_faults_;
+            long references = faults + swap.hits_;
+
+            out_ << "Page faults: " << faults;
+            out_ << " (" << swap.minor_faults_ << " minor, " << swap.major_faults_ << " major)" << endl;
+            out_ << "References: " << references << ", fault rate ";
+            out_ << (references > 0 ? faults * 100.0 / references : 0) << "%" << endl;
+
+            if (swap.prefetch_limit_ == 0) {
+                out_ << "Prefetch: DISABLED" << endl;
+            } else {
+                long settled = swap.prefetch_hits_ + swap.prefetch_wasted_;
+
+                out_ << "Prefetch: " << swap.prefetches_ << " pages (up to " << swap.prefetch_limit_;
+                out_ << " per fault), " << swap.prefetch_hits_ << " used, " << swap.prefetch_wasted_;
+                out_ << " evicted unused (" << (settled > 0 ? swap.prefetch_hits_ * 100.0 / settled : 0);
+                out_ << "% accurate)" << endl;
+            }
+
+            out_ << "Dirty pages: " << swap.dirty_pages_ << "/" << swap.frame_count_ << " (";
+            out_ << (swap.frame_count_ > 0 ? swap.dirty_pages_ * 100.0 / swap.frame_count_ : 0) << "%), ";
+            out_ << swap.dirty_evictions_ << " evicted dirty" << endl;
+
+            if (swap.writeback_batch_ == 0) {
+                out_ << "Write-back: DISABLED" << endl;
+            } else {
+                long writes = swap.writeback_writes_;
+
+                out_ << "Write-back: " << swap.writeback_pages_ << " pages in " << writes;
+                out_ << " writes of up to " << swap.writeback_batch_ << " (avg ";
+                out_ << (writes > 0 ? (double) swap.writeback_pages_ / writes : 0);
+                out_ << " pages, " << (writes > 0 ? (double) swap.writeback_runs_ / writes : 0);
+                out_ << " runs per write), " << swap.pending_pages_ << " pages pending" << endl;
+                out_ << "Flusher: " << swap.flushed_pages_ << " pages cleaned above " << swap.dirty_ratio_;
+                out_ << "% dirty" << endl;
+            }
+
+            if (!swap.swap_enabled_) {
+                out_ << "Swap: DISABLED" << endl;
+                out_ << endl;
+                return;
+            }
+
+            out_ << "Swap slots: " << swap.swap_.used_slots_ << "/" << swap.swap_.capacity_ << " used" << endl;
+            out_ << "Swap outs: " << swap.swap_.swap_outs_ << ", swap ins: " << swap.swap_.swap_ins_;
+            out_ << ", dropped: " << swap.swap_.dropped_ << endl;
+            out_ << "Modeled swap time: " << swap.swap_.swap_time_us_ << " us" << endl;
+            out_ << endl;
+        }
+
+        /**
+         * Prints the placement policy and the counters of every NUMA node.
+         */
+        void showNodes(const NodeSnapshot& nodes) {
+            const NumaConfig &numa = nodes.numa_;
+
+            out_ << "NUMA policy: " << (numa.policy_ == NUMA_INTERLEAVE ? "interleave" : "first-touch");
+            out_ << ", access " << numa.local_ns_ << " ns local, " << numa.remote_ns_ << " ns remote, ";
+            if (numa.migrate_after_ > 0) {
+                out_ << "migration after " << numa.migrate_after_ << " remote references" << endl;
+            } else {
+                out_ << "migration off" << endl;
+            }
+
+            for (size_t n = 0; n < nodes.nodes_.size(); n++) {
+                const NodeStats &node = nodes.nodes_[n];
+                long local = node.local_accesses_;
+                long remote = node.remote_accesses_;
+
+                out_ << "Node " << n << ": " << node.active_count_ << "/" << node.frame_count_;
+                out_ << " frames used" << endl;
+                out_ << "\t Faults: " << node.faults_ << ", evictions: " << node.evictions_;
+                out_ << ", migrations in: " << node.migrations_ << endl;
+                out_ << "\t Accesses: " << local << " local, " << remote << " remote (";
+                out_ << (local + remote > 0 ? remote * 100.0 / (local + remote) : 0) << "% remote)";
+                out_ << ", modeled time " << node.access_time_ns_ / 1000 << " us" << endl;
+            }
+            out_ << endl;
+        }
+
+        /**
+         * Prints the quota policy and, for every process, its quota, resident
+         * frames, fault rate and how many of its pages it evicted itself or
+         * lost to other processes.
+         */
+        void showQuotas(const QuotaSnapshot& quotas) {
+            if (quotas.config_.policy_ == QUOTA_OFF) {
+                out_ << "Quotas: DISABLED" << endl;
+                out_ << endl;
+                return;
+            }
+
+            long faults = 0;
+            long references = 0;
+
+            out_ << "Quotas: " << (quotas.config_.policy_ == QUOTA_PRIORITY ? "by priority" : "proportional to size");
+            out_ << ", " << (quotas.config_.scope_ == SCOPE_LOCAL ? "local" : "global") << " replacement, ";
+            out_ << quotas.frame_count_ << " frames" << endl;
+
+            for (auto &process : quotas.processes_) {
+                out_ << "Process " << process.pid_ << ": " << process.resident_ << "/" << process.quota_;
+                out_ << " frames (priority " << process.priority_ << ", size " << process.size_ << " pages)" << endl;
+                out_ << "\t Faults: " << process.faults_ << " in " << process.references_ << " references (";
+                out_ << process.faultRate() * 100 << "%), " << process.own_evictions_ << " own pages evicted, ";
+                out_ << process.stolen_ << " taken by others" << endl;
+
+                faults += process.faults_;
+                references += process.references_;
+            }
+
+            out_ << "Total: " << faults << " faults in " << references << " references (";
+            out_ << (references > 0 ? faults * 100.0 / references : 0) << "%)" << endl;
+            out_ << endl;
+        }
+
+        /**
+         * Shows every disk: IDLE, or the entry using the disk and those waiting
+         * for it, followed by its statistics. Then the disk groups.
+         */
+        void showIO(const IoSnapshot& io) {
+            for (size_t i = 0; i < io.disks_.size(); i++) {
+                const DiskSnapshot &disk = io.disks_[i];
+
+                out_ << "Disk " << i << ": ";
+                if (disk.entries_.empty()) {
+                    out_ << "IDLE" << endl;
+                } else {
+                    showEntry(disk.entries_[0]);
+
+                    if (disk.entries_.size() > 1) {
+                        out_ << "Waiting:" << endl;
+                        for (size_t e = 1; e < disk.entries_.size(); e++) {
+                            out_ << "\t ";
+                            showEntry(disk.entries_[e]);
+                        }
+                    }
+                }
+
+                if ((int) i == io.writeback_disk_) {
+                    out_ << "\t Write-back: " << io.writeback_requests_ << " requests, ";
+                    out_ << io.writeback_completed_ << " completed" << endl;
+                }
+                if (!io.cache_.empty()) {
+                    showCache(io.cache_[i], disk.stats_.wait_.mean() + disk.stats_.service_.mean(), io.time_);
+                }
+                showStats(disk, io.time_);
+
+                if (!io.backing_.empty()) {
+                    showBackingStats(io.backing_[i]);
+                }
+            }
+
+            for (size_t g = 0; g < io.groups_.size(); g++) {
+                showGroup(io, g);
+            }
+
+            if (io.cache_capacity_ > 0) {
+                out_ << "Buffer cache: " << (io.cache_policy_ == CACHE_2Q ? "2Q" : "LRU") << ", ";
+                out_ << io.cache_blocks_ << " of " << io.cache_capacity_ << " blocks" << endl;
+            }
+        }
+
+        void showEntry(const DiskEntry& entry) {
+            if (entry.pid_ == kKernelPid) {
+                out_ << "Write-back of " << entry.pages_ << " pages" << endl;
+            } else {
+                out_ << "Process " << entry.pid_ << " " << entry.filename_ << endl;
+            }
+        }
+
+        /**
+         * @disk: the disk whose latency percentiles, utilization and queue
+         * depth are printed.
+         * @now: time of the snapshot.
+         */
+        void showStats(const DiskSnapshot& disk, long now) {
+            const DiskStats &stats = disk.stats_;
+
+            out_ << "\t Requests: " << stats.completed_ << " completed, ";
+            out_ << stats.aborted_ << " aborted" << endl;
+            out_ << "\t Utilization: " << stats.utilization(now) * 100 << "%, queue depth ";
+            out_ << disk.entries_.size() << " (avg " << stats.averageDepth(now);
+            out_ << ", max " << stats.max_depth_ << ")" << endl;
+            out_ << "\t Wait (ticks):    p50 " << stats.wait_.percentile(0.5);
+            out_ << ", p99 " << stats.wait_.percentile(0.99);
+            out_ << ", p999 " << stats.wait_.percentile(0.999);
+            out_ << ", max " << stats.wait_.max() << endl;
+            out_ << "\t Service (ticks): p50 " << stats.service_.percentile(0.5);
+            out_ << ", p99 " << stats.service_.percentile(0.99);
+            out_ << ", p999 " << stats.service_.percentile(0.999);
+            out_ << ", max " << stats.service_.max() << endl;
+            out_ << endl;
+        }
+
+        /**
+         * @stats: the buffer cache counters of one disk or group.
+         * @sojourn: average ticks a request of that disk takes, used to
+         * estimate how much the hits shortened its queue.
+         * @now: time of the snapshot.
+         */
+        void showCache(const CacheStats& stats, double sojourn, long now) {
+            out_ << "\t Cache: " << stats.hits_ << " hits, " << stats.misses_ << " misses (";
+            out_ << stats.hitRatio() * 100 << "%), " << stats.writes_ << " writes, ";
+            out_ << "avg queue depth " << stats.depthSaved(sojourn, now) << " lower" << endl;
+        }
+
+        /**
+         * @stats: the measured I/O statistics of one disk.
+         */
+        void showBackingStats(const DiskIoStats& stats) {
+            out_ << "\t Backing I/O: " << stats.reads_ << " reads, " << stats.writes_ << " writes, ";
+            out_ << stats.errors_ << " errors" << endl;
+            out_ << "\t Latency: avg " << stats.averageLatency() << " us, max ";
+            out_ << stats.max_latency_us_ << " us" << endl;
+            out_ << "\t Throughput: " << stats.throughput() << " MB/s" << endl;
+            out_ << endl;
+        }
+
+        /**
+         * @io: the snapshot holding the group.
+         * @g: index of the group whose counters are printed. The member queues
+         * are printed with the physical disks.
+         */
+        void showGroup(const IoSnapshot& io, size_t g) {
+            const DiskGroup &group = io.groups_[g];
+            size_t disk_number = io.disks_.size() + g;
+
+            out_ << "Disk " << disk_number << ": ";
+            out_ << (group.level_ == RAID_0 ? "RAID-0" : "RAID-1") << " group of disks";
+            for (auto &member : group.members_) {
+                out_ << " " << member;
+            }
+            out_ << endl;
+
+            out_ << "\t Requests: " << group.requests_ << " made (" << group.parts_ << " parts), ";
+            out_ << group.completed_ << " completed, " << group.aborted_ << " aborted, ";
+            out_ << group.requests_ - group.completed_ - group.aborted_ << " in flight" << endl;
+            out_ << "\t Latency (ticks): p50 " << group.latency_.percentile(0.5);
+            out_ << ", p99 " << group.latency_.percentile(0.99);
+            out_ << ", p999 " << group.latency_.percentile(0.999);
+            out_ << ", max " << group.latency_.max() << endl;
+            if (!io.cache_.empty()) {
+                showCache(io.cache_[disk_number], group.latency_.mean(), io.time_);
+            }
+            out_ << endl;
+        }
+
+        /**
+         * Prints the statistics of every disk and group as one JSON object so
+         * they can be collected by scripts.
+         */
+        void showIOJson(const IoSnapshot& io) {
+            out_ << "{\"time\":" << io.time_ << ",\"disks\":[";
+            for (size_t i = 0; i < io.disks_.size(); i++) {
+                const DiskStats &stats = io.disks_[i].stats_;
+
+                out_ << (i > 0 ? "," : "") << "{\"completed\":" << stats.completed_;
+                out_ << ",\"aborted\":" << stats.aborted_;
+                out_ << ",\"queue_depth\":" << io.disks_[i].entries_.size();
+                out_ << ",\"avg_queue_depth\":" << stats.averageDepth(io.time_);
+                out_ << ",\"max_queue_depth\":" << stats.max_depth_;
+                out_ << ",\"utilization\":" << stats.utilization(io.time_);
+                out_ << ",\"wait\":";
+                histogramJson(stats.wait_);
+                out_ << ",\"service\":";
+                histogramJson(stats.service_);
+                out_ << ",\"depth_series\":[";
+                for (size_t d = 0; d < stats.depth_series_.size(); d++) {
+                    const DepthSample &sample = stats.depth_series_[d];
+                    out_ << (d > 0 ? "," : "") << "[" << sample.time_ << "," << sample.depth_ << "]";
+                }
+                out_ << "]";
+                if (!io.cache_.empty()) {
+                    cacheJson(io.cache_[i], stats.wait_.mean() + stats.service_.mean(), io.time_);
+                }
+                out_ << "}";
+            }
+            out_ << "],\"groups\":[";
+            for (size_t g = 0; g < io.groups_.size(); g++) {
+                const DiskGroup &group = io.groups_[g];
+
+                out_ << (g > 0 ? "," : "") << "{\"disk\":" << io.disks_.size() + g;
+                out_ << ",\"raid\":" << (group.level_ == RAID_0 ? 0 : 1) << ",\"members\":[";
+                for (size_t m = 0; m < group.members_.size(); m++) {
+                    out_ << (m > 0 ? "," : "") << group.members_[m];
+                }
+                out_ << "],\"requests\":" << group.requests_ << ",\"parts\":" << group.parts_;
+                out_ << ",\"completed\":" << group.completed_ << ",\"aborted\":" << group.aborted_;
+                out_ << ",\"latency\":";
+                histogramJson(group.latency_);
+                if (!io.cache_.empty()) {
+                    cacheJson(io.cache_[io.disks_.size() + g], group.latency_.mean(), io.time_);
+                }
+                out_ << "}";
+            }
+            out_ << "]";
+            if (io.cache_capacity_ > 0) {
+                out_ << ",\"cache_policy\":\"" << (io.cache_policy_ == CACHE_2Q ? "2q" : "lru") << "\"";
+                out_ << ",\"cache_capacity\":" << io.cache_capacity_;
+                out_ << ",\"cache_blocks\":" << io.cache_blocks_;
+            }
+            out_ << "}" << endl;
+        }
+
+        /**
+         * Appends the buffer cache counters of one disk or group to its JSON
+         * object, see showCache().
+         */
+        void cacheJson(const CacheStats& stats, double sojourn, long now) {
+            out_ << ",\"cache\":{\"hits\":" << stats.hits_ << ",\"misses\":" << stats.misses_;
+            out_ << ",\"writes\":" << stats.writes_ << ",\"hit_ratio\":" << stats.hitRatio();
+            out_ << ",\"depth_saved\":" << stats.depthSaved(sojourn, now) << "}";
+        }
+
+        /**
+         * Prints the count, mean, percentiles and non-empty buckets, as
+         * [upper bound, count], of a histogram as a JSON object.
+         */
+        void histogramJson(const LatencyHistogram& histogram) {
+            out_ << "{\"count\":" << histogram.count() << ",\"mean\":" << histogram.mean();
+            out_ << ",\"p50\":" << histogram.percentile(0.5);
+            out_ << ",\"p99\":" << histogram.percentile(0.99);
+            out_ << ",\"p999\":" << histogram.percentile(0.999);
+            out_ << ",\"max\":" << histogram.max() << ",\"buckets\":[";
+
+            bool first = true;
+            for (int i = 0; i < LatencyHistogram::kBuckets; i++) {
+                if (histogram.bucketCount(i) == 0) { continue; }
+
+                out_ << (first ? "" : ",") << "[" << LatencyHistogram::upperBound(i);
+                out_ << "," << histogram.bucketCount(i) << "]";
+                first = false;
+            }
+            out_ << "]}";
+        }
+};
+
+#endif
@@ -0,0 +1,383 @@
+/**
+ * Header file for the copy-on-write containers used to branch the simulator
+ * (see OperatingSystem::branch()). Copying a CowArray or a CowValue takes
+ * constant time: the copy shares everything with the original and a part is
+ * only copied once one of the two changes it.
+ */
+
+#ifndef COW_ARRAY_H
+#define COW_ARRAY_H
+
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+/**
+ * An array split into chunks of kChunkSize elements that can be shared by
+ * several CowArrays. Every CowArray has an owner id, and a chunk is tagged with
+ * the id of the only array allowed to change it in place. Copying an array
+ * gives both arrays new ids, so every chunk becomes shared. Changing an element
+ * through edit(...) copies its chunk first if the chunk is shared, so the cost
+ * of a copy is paid a chunk at a time and only for the chunks that change.
+ *
+ * Reading and editing elements may be done from several threads at once, like
+ * with a vector, plus the copying of shared chunks is locked. Copying, assigning
+ * and resizing an array must not happen while another thread uses it. Copies
+ * can be used from different threads at the same time.
+ */
+template <class T>
+class CowArray {
+    public:
+        static const int kChunkShift = 10;
+        static const size_t kChunkSize = (size_t) 1 << kChunkShift;
+
+        CowArray() : size_{0}, owner_{newOwner()}, directory_{new Directory(owner_)}
+            { }
+
+        /**
+         * @other: the array shared with, in constant time.
+         */
+        CowArray(const CowArray& other) :
+            size_{other.size_}, owner_{newOwner()}, directory_{other.directory_}
+            {
+                acquire(directory_);
+                other.owner_ = newOwner();
+                other.clearRetired();
+            }
+
+        CowArray& operator=(const CowArray& other) {
+            if (this == &other) { return *this; }
+
+            Directory* directory = other.directory_;
+            acquire(directory);
+            release(directory_);
+            clearRetired();
+
+            directory_ = directory;
+            size_ = other.size_;
+            owner_ = newOwner();
+            other.owner_ = newOwner();
+            other.clearRetired();
+
+            return *this;
+        }
+
+        ~CowArray() {
+            release(directory_);
+            clearRetired();
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        const T& operator[](size_t index) const {
+            Directory* directory = __atomic_load_n(&directory_, __ATOMIC_ACQUIRE);
+            Chunk* chunk = __atomic_load_n(&directory->chunks_[index >> kChunkShift], __ATOMIC_ACQUIRE);
+
+            return chunk->items_[index & (kChunkSize - 1)];
+        }
+
+        const T& back() const {
+            return (*this)[size_ - 1];
+        }
+
+        /**
+         * @index: first element of the run.
+         * @length: receives the number of elements of the run.
+         *
+         * Returns the elements from @index to the end of its chunk (or of the
+         * array), which are stored one after the other, for loops over many
+         * elements.
+         */
+        const T* run(size_t index, size_t& length) const {
+            Directory* directory = __atomic_load_n(&directory_, __ATOMIC_ACQUIRE);
+            Chunk* chunk = __atomic_load_n(&directory->chunks_[index >> kChunkShift], __ATOMIC_ACQUIRE);
+
+            length = kChunkSize - (index & (kChunkSize - 1));
+            if (length > size_ - index) { length = size_ - index; }
+
+            return &chunk->items_[index & (kChunkSize - 1)];
+        }
+
+        /**
+         * @index: element that is about to be changed.
+         *
+         * Returns the element, after copying its chunk if the chunk is shared.
+         */
+        T& edit(size_t index) {
+            Directory* directory = __atomic_load_n(&directory_, __ATOMIC_ACQUIRE);
+            Chunk* chunk = __atomic_load_n(&directory->chunks_[index >> kChunkShift], __ATOMIC_ACQUIRE);
+
+            if (__atomic_load_n(&chunk->owner_, __ATOMIC_ACQUIRE) != owner_) {
+                chunk = unshare(index >> kChunkShift);
+            }
+
+            return chunk->items_[index & (kChunkSize - 1)];
+        }
+
+        /**
+         * @count: the new number of elements.
+         * @value: the value of every element.
+         */
+        void assign(size_t count, const T& value) {
+            release(directory_);
+            clearRetired();
+
+            owner_ = newOwner();
+            directory_ = new Directory(owner_);
+            size_ = 0;
+            resize(count, value);
+        }
+
+        /**
+         * @count: the new number of elements. Elements added at the end get
+         * @value, chunks are only allocated as they are needed.
+         */
+        void resize(size_t count, const T& value = T()) {
+            if (count > size_) {
+                lock_guard<mutex> lock(mutex_);
+                ownDirectory();
+
+                while (directory_->chunks_.size() * kChunkSize < count) {
+                    directory_->chunks_.push_back(new Chunk(owner_));
+                }
+            }
+
+            for (size_t i = size_; i < count; i++) {
+                edit(i) = value;
+            }
+            size_ = count;
+        }
+
+        void push_back(const T& value) {
+            resize(size_ + 1, value);
+        }
+
+        void pop_back() {
+            size_--;
+        }
+
+    private:
+        /**
+         * @refs_: directories (or retired lists) holding the chunk.
+         * @owner_: the array that may change the chunk in place.
+         */
+        struct Chunk {
+            long refs_;
+            long owner_;
+            T items_[kChunkSize];
+
+            explicit Chunk(long owner) : refs_{1}, owner_{owner}, items_()
+                { }
+        };
+
+        /**
+         * @refs_: arrays (or retired lists) holding the directory.
+         * @owner_: the array that may change the directory in place.
+         * @chunks_: the chunks, each holding a reference.
+         */
+        struct Directory {
+            long refs_;
+            long owner_;
+            vector<Chunk*> chunks_;
+
+            explicit Directory(long owner) : refs_{1}, owner_{owner}
+                { }
+        };
+
+        /**
+         * @size_: number of elements.
+         * @owner_: id of this array, changed every time it is copied.
+         * @directory_: the chunks of the array.
+         * @mutex_: serializes the copying of shared chunks.
+         * @retired_directories_: directories replaced by a copy. They are kept
+         * until the array is copied or destroyed since another thread may
+         * still be reading through them.
+         * @retired_chunks_: chunks replaced by a copy, kept for the same reason.
+         */
+        size_t size_;
+        mutable long owner_;
+        Directory* directory_;
+        mutex mutex_;
+        mutable vector<Directory*> retired_directories_;
+        mutable vector<Chunk*> retired_chunks_;
+
+        static long newOwner() {
+            static long last_owner = 0;
+            return __atomic_add_fetch(&last_owner, 1, __ATOMIC_RELAXED);
+        }
+
+        template <class Part>
+        static void acquire(Part* part) {
+            __atomic_add_fetch(&part->refs_, 1, __ATOMIC_RELAXED);
+        }
+
+        template <class Part>
+        static bool shared(Part* part) {
+            return __atomic_load_n(&part->refs_, __ATOMIC_ACQUIRE) > 1;
+        }
+
+        static void release(Chunk* chunk) {
+            if (__atomic_sub_fetch(&chunk->refs_, 1, __ATOMIC_ACQ_REL) == 0) {
+                delete chunk;
+            }
+        }
+
+        static void release(Directory* directory) {
+            if (__atomic_sub_fetch(&directory->refs_, 1, __ATOMIC_ACQ_REL) != 0) { return; }
+
+            for (auto &chunk : directory->chunks_) {
+                release(chunk);
+            }
+            delete directory;
+        }
+
+        void clearRetired() const {
+            for (auto &directory : retired_directories_) {
+                release(directory);
+            }
+            for (auto &chunk : retired_chunks_) {
+                release(chunk);
+            }
+
+            retired_directories_.clear();
+            retired_chunks_.clear();
+        }
+
+        /**
+         * Makes @directory_ one only this array holds, copying it if it is
+         * shared. Caller must hold @mutex_.
+         */
+        void ownDirectory() {
+            if (directory_->owner_ == owner_) { return; }
+
+            if (!shared(directory_)) {
+                directory_->owner_ = owner_;
+                return;
+            }
+
+            Directory* copy = new Directory(owner_);
+            copy->chunks_ = directory_->chunks_;
+            for (auto &chunk : copy->chunks_) {
+                acquire(chunk);
+            }
+
+            retired_directories_.push_back(directory_);
+            __atomic_store_n(&directory_, copy, __ATOMIC_RELEASE);
+        }
+
+        /**
+         * @chunk_num: chunk that is about to be changed.
+         *
+         * Returns the chunk after making it one only this array holds. A chunk
+         * nobody else holds is just tagged with @owner_, a shared one is copied.
+         */
+        Chunk* unshare(size_t chunk_num) {
+            lock_guard<mutex> lock(mutex_);
+            ownDirectory();
+
+            Chunk* chunk = directory_->chunks_[chunk_num];
+            if (chunk->owner_ == owner_) { return chunk; }
+
+            if (!shared(chunk)) {
+                __atomic_store_n(&chunk->owner_, owner_, __ATOMIC_RELEASE);
+                return chunk;
+            }
+
+            Chunk* copy = new Chunk(owner_);
+            for (size_t i = 0; i < kChunkSize; i++) {
+                copy->items_[i] = chunk->items_[i];
+            }
+
+            retired_chunks_.push_back(chunk);
+            __atomic_store_n(&directory_->chunks_[chunk_num], copy, __ATOMIC_RELEASE);
+
+            return copy;
+        }
+};
+
+/**
+ * A value that can be shared by several CowValues. Reading goes through * and
+ * ->, changing it through edit(), which copies the value first if another
+ * CowValue still shares it. Copying a CowValue takes constant time.
+ *
+ * Used for the parts of the simulator that are changed as a whole, like a
+ * disk queue or a hash table, under a lock of their owner. The count of
+ * sharers is read with acquire ordering, so a value the other sharers just
+ * finished copying is never changed under them.
+ */
+template <class T>
+class CowValue {
+    public:
+        CowValue() : box_{new Box()}
+            { }
+
+        CowValue(const CowValue& other) : box_{other.box_}
+            {
+                __atomic_add_fetch(&box_->refs_, 1, __ATOMIC_RELAXED);
+            }
+
+        CowValue& operator=(const CowValue& other) {
+            Box* box = other.box_;
+
+            __atomic_add_fetch(&box->refs_, 1, __ATOMIC_RELAXED);
+            release(box_);
+            box_ = box;
+
+            return *this;
+        }
+
+        ~CowValue() {
+            release(box_);
+        }
+
+        const T& operator*() const {
+            return box_->value_;
+        }
+
+        const T* operator->() const {
+            return &box_->value_;
+        }
+
+        T& edit() {
+            if (__atomic_load_n(&box_->refs_, __ATOMIC_ACQUIRE) > 1) {
+                Box* copy = new Box(box_->value_);
+
+                release(box_);
+                box_ = copy;
+            }
+            return box_->value_;
+        }
+
+    private:
+        /**
+         * @refs_: CowValues sharing the value.
+         * @value_: the value.
+         */
+        struct Box {
+            long refs_;
+            T value_;
+
+            Box() : refs_{1}, value_()
+                { }
+
+            explicit Box(const T& value) : refs_{1}, value_(value)
+                { }
+        };
+
+        Box* box_;
+
+        static void release(Box* box) {
+            if (__atomic_sub_fetch(&box->refs_, 1, __ATOMIC_ACQ_REL) == 0) {
+                delete box;
+            }
+        }
+};
+
+#endif
@@ -1,36 +1,187 @@
 #ifndef DISKS_H
 #define DISKS_H
 
-#include <iostream>
+#include <algorithm>
 #include <list>
 #include <string>
+#include <vector>
 
+#include "histogram.h"
 #include "process.h"
 
 /**
- * Struct to hold the process and filename.
+ * Pid of the entries the OS queues for itself, like the write-back of dirty
+ * pages. No process ever gets it.
+ */
+const int kKernelPid = 0;
+
+/**
+ * Struct to hold the pid of the process and filename. @pages_ is the number
+ * of pages of a write-back entry, 0 for the entries of processes.
  */
 struct DiskEntry {
-    Process* process_;
+    int pid_;
     string filename_;
+    long request_id_;
+    bool write_;
+    long enqueued_at_;
+    long started_at_;
+    int pages_;
+
+    DiskEntry() : pid_{0}, filename_{""}, request_id_{0}, write_{false},
+        enqueued_at_{0}, started_at_{0}, pages_{0}
+        { }
+
+    DiskEntry(int pid, string filename) :
+        pid_{pid}, filename_{filename}, request_id_{0}, write_{false},
+        enqueued_at_{0}, started_at_{0}, pages_{0}
+        { }
+
+    DiskEntry(int pid, string filename, long request_id, bool write, long now) :
+        pid_{pid}, filename_{filename}, request_id_{request_id}, write_{write},
+        enqueued_at_{now}, started_at_{now}, pages_{0}
+        { }
+};
+
+/**
+ * Struct for one point of a disk's queue-depth time series.
+ */
+struct DepthSample {
+    long time_;
+    int depth_;
+};
+
+/**
+ * Struct that holds the statistics of one disk. All times are in ticks of the
+ * simulated clock (one tick per command, see OperatingSystem::advanceClock()).
+ *
+ * @wait_: time requests spent in the queue before reaching the disk.
+ * @service_: time requests spent using the disk.
+ * @completed_: requests that finished.
+ * @aborted_: requests removed because their process was terminated.
+ * @busy_time_: time the disk had at least one request.
+ * @depth_area_: integral of the queue depth over time, for the average depth.
+ * @max_depth_: deepest the queue has been.
+ * @depth_series_: the last kDepthSamples changes of the queue depth.
+ */
+struct DiskStats {
+    static const int kDepthSamples = 256;
 
-    DiskEntry() : process_{nullptr}, filename_{""} 
+    LatencyHistogram wait_;
+    LatencyHistogram service_;
+    long completed_;
+    long aborted_;
+    long busy_time_;
+    long depth_area_;
+    int max_depth_;
+    vector<DepthSample> depth_series_;
+    long depth_series_start_;
+
+    DiskStats() : completed_{0}, aborted_{0}, busy_time_{0}, depth_area_{0}, max_depth_{0},
+        depth_series_start_{0}
         { }
-    
-    DiskEntry(Process* process, string filename) : 
-        process_{process}, filename_{filename}
-        { }      
+
+    /**
+     * @elapsed: ticks since the disk was created.
+     */
+    double utilization(long elapsed) const {
+        return elapsed > 0 ? (double) busy_time_ / elapsed : 0;
+    }
+
+    double averageDepth(long elapsed) const {
+        return elapsed > 0 ? (double) depth_area_ / elapsed : 0;
+    }
+};
+
+/**
+ * Struct that holds a copy of the queue and the statistics of one disk. The
+ * first entry is the one using the disk, and the depth series is in time order.
+ */
+struct DiskSnapshot {
+    vector<DiskEntry> entries_;
+    DiskStats stats_;
+};
+
+/**
+ * How a disk group spreads its requests over its member disks.
+ * RAID 0 stripes every request over all the members. RAID 1 mirrors: a read
+ * goes to the member with the shortest queue, a write to every member.
+ */
+enum RaidLevel {
+    RAID_0,
+    RAID_1
+};
+
+/**
+ * Struct for a group of disks that is used like a single disk. Groups are
+ * numbered after the physical disks.
+ *
+ * @level_: striping or mirroring.
+ * @members_: the physical disks of the group.
+ * @requests_: requests sent to the group.
+ * @parts_: entries put in the member queues for those requests.
+ * @completed_: requests whose every part finished.
+ * @aborted_: requests removed because their process was terminated.
+ * @latency_: time from a request being made until its last part finished.
+ */
+struct DiskGroup {
+    RaidLevel level_;
+    vector<int> members_;
+    long requests_;
+    long parts_;
+    long completed_;
+    long aborted_;
+    LatencyHistogram latency_;
+
+    DiskGroup(RaidLevel level, vector<int> members) : level_{level}, members_{members},
+        requests_{0}, parts_{0}, completed_{0}, aborted_{0}
+        { }
+};
+
+/**
+ * Struct for a request made to a disk group that still has parts in the
+ * member queues. A blocked process has at most one, so they are kept by pid.
+ *
+ * @group_: index of the group in the OS's groups.
+ * @parts_left_: parts that did not finish yet.
+ * @made_at_: time the request was made.
+ */
+struct GroupRequest {
+    int group_;
+    int parts_left_;
+    long made_at_;
 };
 
 /**
  * Class that will be used to simulate the disk usage for our operating system.
+ * A Disk has no lock of its own: the OperatingSystem only reaches it under
+ * its scheduler lock, so the disks are serialized by that lock. A disk that
+ * is shared between branches is never changed, see cow_array.h.
+ *
+ * Every method that changes the queue takes the current simulated time so the
+ * disk can keep its latency, utilization and queue-depth statistics.
  */
 class Disk {
     public:
         /**
          * Default constuctor
          */
-        Disk() { } 
+        Disk() : last_change_{0}
+            { }
+
+        /**
+         * @other: the disk whose entries and statistics are copied, used when
+         * a branch of the OS changes a disk it shares (see cow_array.h).
+         */
+        Disk(const Disk& other) {
+            for (auto &entry : other.queue_) {
+                queue_.push_back(new DiskEntry(*entry));
+            }
+            stats_ = other.stats_;
+            last_change_ = other.last_change_;
+        }
+
+        Disk& operator=(const Disk&) = delete;
 
         /**
          * Destructor that removes all the memory for all of the entries.
@@ -41,75 +192,159 @@ class Disk {
                 entry = nullptr;
             }
         }
-        
+
         /**
-         * @process: process that will be using the disk.
+         * @pid: process that will be using the disk.
          * @filename: the name of the file that the process wants to use.
-         * 
+         * @request_id: unique id used to match the entry with its backing-file I/O.
+         * @write: true if the file will be written instead of read.
+         * @now: current simulated time.
+         *
          * Creates a new disk entry and then pushes it to the @queue_.
          */
-        void addEntry(Process* process, string filename) {
-            DiskEntry* toBeAdded = new DiskEntry{process, filename};
-            queue_.push_back(toBeAdded);
+        void addEntry(int pid, string filename, long request_id, bool write, long now) {
+            push(new DiskEntry{pid, filename, request_id, write, now}, now);
         }
 
         /**
-         * Simple function the outputs the state of the @queue_ for the disk.
-         * if there is nothing being used by the disk then function outputs IDLE.
-         * Otherwise it shows the current process using the disk and those waiting
-         * to use the disk.
+         * @pages: number of dirty pages written by the request.
+         * @request_id: unique id used to match the entry with its backing-file I/O.
+         * @now: current simulated time.
+         * 
+         * Queues a write-back of the OS. It waits for the disk like the
+         * requests of the processes, but no process is blocked on it.
          */
-        void showEntries() {
-            if (queue_.empty()) {
-                cout << "IDLE" << endl;
-            } else {
-                cout << *queue_.front()->process_ << " ";
-                cout << queue_.front()->filename_ << endl;
-
-                if (queue_.size() > 1) {
-                    cout << "Waiting:" << endl;
-                    for (auto &entry : queue_) {
-                        if (entry == queue_.front()) { continue; }
-                        
-                        cout << "\t " << *entry->process_ << " ";
-                        cout << entry->filename_ << endl;
-                    }
-                }
+        void addWriteBack(int pages, long request_id, long now) {
+            DiskEntry* toBeAdded = new DiskEntry{kKernelPid, "write-back", request_id, true, now};
+            toBeAdded->pages_ = pages;
+
+            push(toBeAdded, now);
+        }
+
+        /**
+         * @entry: receives a copy of the entry currently using the disk.
+         *
+         * Returns false if the disk is idle.
+         */
+        bool frontEntry(DiskEntry& entry) const {
+            if (queue_.empty()) { return false; }
+
+            entry = *queue_.front();
+            return true;
+        }
+
+        /**
+         * Returns the request id of the entry currently using the disk or 0
+         * if the disk is idle.
+         */
+        long frontRequestId() const {
+            if (queue_.empty()) { return 0; }
+
+            return queue_.front()->request_id_;
+        }
+
+        /**
+         * Returns the number of entries using or waiting for the disk.
+         */
+        int queueDepth() const {
+            return queue_.size();
+        }
+
+        /**
+         * Returns whether no process is using or waiting for the disk.
+         */
+        bool isIdle() const {
+            return queue_.empty();
+        }
+
+        /**
+         * Returns whether @pid is using or waiting for the disk.
+         */
+        bool hasEntry(int pid) const {
+
+            for (auto &entry : queue_) {
+                if (entry->pid_ == pid) { return true; }
             }
-            cout << endl;
+            return false;
         }
 
-        Process* seachDisks(int pid) {
+        /**
+         * @now: current simulated time.
+         * 
+         * Returns the entries using and waiting for the disk and its latency,
+         * utilization and queue-depth statistics up to @now.
+         */
+        DiskSnapshot snapshot(long now) const {
+            DiskSnapshot snapshot;
+
             for (auto &entry : queue_) {
-                if (entry->process_->getPID() == pid) {
-                    return entry->process_;
-                }
+                snapshot.entries_.push_back(*entry);
             }
 
-            return nullptr;
+            snapshot.stats_ = stats_;
+            addElapsed(snapshot.stats_, now);
+            rotate(snapshot.stats_.depth_series_.begin(),
+                   snapshot.stats_.depth_series_.begin() + stats_.depth_series_start_,
+                   snapshot.stats_.depth_series_.end());
+            snapshot.stats_.depth_series_start_ = 0;
+
+            return snapshot;
         }
 
         /**
-         * The disk is finished being used and the process using the disk 
-         * will be returned to the @ready_queue
+         * @now: current simulated time.
+         * @pid: receives the pid of the process that was using the disk,
+         * kKernelPid for a write-back.
+         * 
+         * The disk is finished being used and the pid of the process using
+         * the disk is handed back so it can go back to the @ready_queue. Returns
+         * false if the disk is idle.
          */
-        Process* finishUsage() {
+        bool finishUsage(long now, int& pid) {
+            if (queue_.empty()) { return false; }
+
+            updateDepth(now);
+
             DiskEntry* temp = queue_.front();
+            pid = temp->pid_;
+
+            stats_.service_.record(now - temp->started_at_);
+            stats_.completed_++;
 
             queue_.pop_front();
+            delete temp;
+
+            if (!queue_.empty()) {
+                startService(now);
+            }
+            recordDepth(now);
 
-            return temp->process_;          
+            return true;
         }
         /**
+         * @pid: the process that was killed.
+         * @now: current simulated time.
+         *
          * If a process has been killed prematurely. This function goes
-         * through processes using the disk and if the @pid matches 
+         * through processes using the disk and if the @pid matches
          * it is removed from the @queue_.
          */
-        void releaseResources(int pid) {
-            for (list<DiskEntry*>::iterator itr = queue_.begin(); 
+        void releaseResources(int pid, long now) {
+
+            for (list<DiskEntry*>::iterator itr = queue_.begin();
                  itr != queue_.end(); ++itr) {
-                     if ( (*itr)->process_->getPID() == pid) {
+                     if ( (*itr)->pid_ == pid) {
+                         bool in_service = itr == queue_.begin();
+
+                         updateDepth(now);
+                         delete (*itr);
                          queue_.erase(itr);
+                         stats_.aborted_++;
+
+                         if (in_service && !queue_.empty()) {
+                             startService(now);
+                         }
+                         recordDepth(now);
                          return;
                      }
                  }
@@ -119,9 +354,83 @@ class Disk {
     private:
         /**
          * @queue_: the queue for the disk.
+         * @stats_: latency, utilization and queue-depth statistics.
+         * @last_change_: time the queue depth last changed.
          */
         list<DiskEntry*> queue_;
+        DiskStats stats_;
+        long last_change_;
 
+        /**
+         * @toBeAdded: the entry that joins the back of the @queue_.
+         * @now: current simulated time.
+         */
+        void push(DiskEntry* toBeAdded, long now) {
+            updateDepth(now);
+            queue_.push_back(toBeAdded);
+
+            if (queue_.size() == 1) {
+                startService(now);
+            }
+            recordDepth(now);
+        }
+
+        /**
+         * @now: time the entry at the front of the queue starts using the disk.
+         */
+        void startService(long now) {
+            DiskEntry* entry = queue_.front();
+
+            entry->started_at_ = now;
+            stats_.wait_.record(now - entry->enqueued_at_);
+        }
+
+        /**
+         * @now: current simulated time.
+         *
+         * Adds the time since the last change to the busy time and the depth
+         * integral. Must be called before the depth changes.
+         */
+        void updateDepth(long now) {
+            if (now <= last_change_) { return; }
+
+            addElapsed(stats_, now);
+            last_change_ = now;
+        }
+
+        /**
+         * @stats: statistics that get the busy time and the depth integral of
+         * the time since the last change, up to @now.
+         */
+        void addElapsed(DiskStats& stats, long now) const {
+            long elapsed = now - last_change_;
+            if (elapsed <= 0) { return; }
+
+            if (!queue_.empty()) {
+                stats.busy_time_ += elapsed;
+            }
+            stats.depth_area_ += elapsed * (long) queue_.size();
+        }
+
+        /**
+         * @now: current simulated time.
+         *
+         * Appends the new depth to the time series, overwriting the oldest
+         * sample once kDepthSamples are kept.
+         */
+        void recordDepth(long now) {
+            int depth = queue_.size();
+            DepthSample sample = {now, depth};
+
+            if (depth > stats_.max_depth_) { stats_.max_depth_ = depth; }
+
+            if ((int) stats_.depth_series_.size() < DiskStats::kDepthSamples) {
+                stats_.depth_series_.push_back(sample);
+            } else {
+                stats_.depth_series_[stats_.depth_series_start_] = sample;
+                stats_.depth_series_start_ = (stats_.depth_series_start_ + 1) % DiskStats::kDepthSamples;
+            }
+        }
 };
 
-#endif
\ No newline at end of file
+#endif
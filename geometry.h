@@ -0,0 +1,178 @@
+/**
+ * Header file for the geometry classes that describe the page size, number of
+ * frames and number of disks of the simulated machine.
+ *
+ * RuntimeGeometry holds those values as regular members and is used for any
+ * configuration typed in at start up. FixedGeometry takes them as template
+ * parameters so the compiler can turn address translation into a shift and
+ * size the frame storage as a fixed array. See simulator.cc for the profiles
+ * that get a FixedGeometry.
+ *
+ * RuntimeGeometry keeps the frames in a CowArray (see cow_array.h) so a branch
+ * of the simulator shares them. A FixedGeometry branch copies its frame array.
+ */
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <array>
+#include <vector>
+
+#include "cow_array.h"
+
+using namespace std;
+
+/**
+ * @value: the number whose base 2 logarithm is returned.
+ *
+ * Returns -1 if @value is not a power of two.
+ */
+constexpr int log2Exact(long value, int shift = 0) {
+    return value == 1 ? shift :
+           (value <= 0 || value % 2 != 0) ? -1 : log2Exact(value / 2, shift + 1);
+}
+
+/**
+ * @storage: container that is resized to @count elements. Fixed size arrays
+ * already have the right size so the overload for them does nothing.
+ */
+template <class T>
+void sizeStorage(vector<T>& storage, int count) {
+    storage.resize(count);
+}
+
+template <class T, size_t N>
+void sizeStorage(array<T, N>&, int) { }
+
+template <class T>
+void sizeStorage(CowArray<T>& storage, int count) {
+    storage.assign(count, T());
+}
+
+/**
+ * @storage: container whose element @index is about to be changed.
+ *
+ * Returns the element. A CowArray copies the chunk holding it first if the
+ * chunk is shared with a branch.
+ */
+template <class T, size_t N>
+T& editable(array<T, N>& storage, size_t index) {
+    return storage[index];
+}
+
+template <class T>
+T& editable(CowArray<T>& storage, size_t index) {
+    return storage.edit(index);
+}
+
+/**
+ * @storage: container read from @index on.
+ * @length: receives the number of elements that follow each other in memory.
+ *
+ * Returns the element at @index, the next @length - 1 elements follow it.
+ */
+template <class T, size_t N>
+const T* readRun(const array<T, N>& storage, size_t index, size_t& length) {
+    length = N - index;
+    return &storage[index];
+}
+
+template <class T>
+const T* readRun(const CowArray<T>& storage, size_t index, size_t& length) {
+    return storage.run(index, length);
+}
+
+/**
+ * Geometry whose values are only known at run time.
+ */
+class RuntimeGeometry {
+    public:
+        template <class T>
+        struct Storage {
+            typedef CowArray<T> Frames;
+            typedef vector<T> Disks;
+        };
+
+        /**
+         * @memory_size: the amount of memory (in bytes).
+         * @page_size: the size of a memory page.
+         * @disk_count: the number of disks.
+         */
+        RuntimeGeometry(long memory_size, int page_size, int disk_count) :
+            page_size_{page_size}, frame_count_{(int) (memory_size / page_size)},
+            disk_count_{disk_count}
+            { }
+
+        /**
+         * @logical_address: address whose page number is returned, must not
+         * be negative. FixedGeometry computes the same page numbers.
+         */
+        int pageNumber(int logical_address) const {
+            return logical_address / page_size_;
+        }
+
+        int pageSize() const {
+            return page_size_;
+        }
+
+        int frameCount() const {
+            return frame_count_;
+        }
+
+        int diskCount() const {
+            return disk_count_;
+        }
+
+    private:
+        int page_size_;
+        int frame_count_;
+        int disk_count_;
+};
+
+/**
+ * Geometry fixed at compile time. Page sizes that are a power of two translate
+ * addresses with a shift, other sizes with a division by a constant.
+ */
+template <int PageSize, int FrameCount, int DiskCount>
+class FixedGeometry {
+    public:
+        static_assert(PageSize > 0 && FrameCount > 0 && DiskCount >= 0,
+                      "FixedGeometry needs a positive page size and frame count");
+
+        static constexpr int kPageShift = log2Exact(PageSize);
+
+        template <class T>
+        struct Storage {
+            typedef array<T, FrameCount> Frames;
+            typedef array<T, DiskCount> Disks;
+        };
+
+        /**
+         * The arguments only exist so both geometries are built the same way.
+         */
+        FixedGeometry(long, int, int) { }
+
+        /**
+         * @logical_address: address whose page number is returned, must not
+         * be negative. The shift gives the same page number as the division
+         * of RuntimeGeometry for every such address.
+         */
+        int pageNumber(int logical_address) const {
+            return kPageShift >= 0 ? logical_address >> (kPageShift & 31)
+                                   : logical_address / PageSize;
+        }
+
+        constexpr int pageSize() const {
+            return PageSize;
+        }
+
+        constexpr int frameCount() const {
+            return FrameCount;
+        }
+
+        constexpr int diskCount() const {
+            return DiskCount;
+        }
+};
+
+#endif
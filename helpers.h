@@ -5,7 +5,7 @@
 
 using namespace std;
 
-bool validateInput(string input) {
+inline bool validateInput(string input) {
     for (size_t i = 0; i < input.length(); i++) {
         if (isalpha(input[i])) {
             return false;
@@ -15,7 +15,7 @@ bool validateInput(string input) {
     return true;
 }
 
-bool isNumber(string input) {
+inline bool isNumber(string input) {
     for (size_t i = 0; i < input.length(); i++) {
         if (!isdigit(input[i])) {
             return false;
@@ -0,0 +1,127 @@
+/**
+ * Header file for the LatencyHistogram class. Values are counted in log-sized
+ * buckets (four buckets per power of two) so a histogram is a fixed, small
+ * array no matter how many values it holds, and percentiles are accurate to
+ * within 25%.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cmath>
+
+using namespace std;
+
+class LatencyHistogram {
+    public:
+        /**
+         * Buckets per power of two and buckets in all, see bucketCount(...).
+         */
+        static const int kSubBuckets = 4;
+        static const int kBuckets = 64 * kSubBuckets;
+
+        LatencyHistogram() : count_{0}, sum_{0}, max_{0}
+            {
+                for (int i = 0; i < kBuckets; i++) {
+                    buckets_[i] = 0;
+                }
+            }
+
+        /**
+         * @value: a latency, must not be negative.
+         */
+        void record(long value) {
+            if (value < 0) { value = 0; }
+
+            buckets_[bucketOf(value)]++;
+            count_++;
+            sum_ += value;
+            if (value > max_) { max_ = value; }
+        }
+
+        long count() const {
+            return count_;
+        }
+
+        long max() const {
+            return max_;
+        }
+
+        double mean() const {
+            return count_ > 0 ? (double) sum_ / count_ : 0;
+        }
+
+        /**
+         * @fraction: the percentile wanted, 0.5 for p50, 0.999 for p999.
+         *
+         * Returns the upper bound of the bucket holding that percentile,
+         * never more than the largest value recorded.
+         */
+        long percentile(double fraction) const {
+            if (count_ == 0) { return 0; }
+
+            long rank = (long) ceil(fraction * count_);
+            if (rank < 1) { rank = 1; }
+            if (rank > count_) { rank = count_; }
+
+            long seen = 0;
+            for (int i = 0; i < kBuckets; i++) {
+                seen += buckets_[i];
+
+                if (seen >= rank) {
+                    long bound = upperBound(i);
+                    return bound < max_ ? bound : max_;
+                }
+            }
+
+            return max_;
+        }
+
+        /**
+         * @bucket: a bucket, from 0 to kBuckets - 1.
+         *
+         * Returns the number of values in @bucket.
+         */
+        long bucketCount(int bucket) const {
+            return buckets_[bucket];
+        }
+
+        /**
+         * Returns the largest value that falls in @bucket.
+         */
+        static long upperBound(int bucket) {
+            if (bucket < kSubBuckets) { return bucket; }
+
+            int power = bucket / kSubBuckets + 1;
+            long sub = bucket % kSubBuckets;
+
+            return ((kSubBuckets + sub + 1) << (power - 2)) - 1;
+        }
+
+    private:
+        /**
+         * @buckets_: number of values in every bucket.
+         * @count_: number of values recorded.
+         * @sum_: sum of all the values, used for the mean.
+         * @max_: the largest value recorded.
+         */
+        long buckets_[kBuckets];
+        long count_;
+        long sum_;
+        long max_;
+
+        /**
+         * Values below 4 get a bucket each. Above that the power of two picks a
+         * group of four buckets and the next two bits pick one of them.
+         */
+        static int bucketOf(long value) {
+            if (value < kSubBuckets) { return (int) value; }
+
+            int power = 63 - __builtin_clzl((unsigned long) value);
+            int sub = (int) ((value >> (power - 2)) & (kSubBuckets - 1));
+
+            return (power - 1) * kSubBuckets + sub;
+        }
+};
+
+#endif
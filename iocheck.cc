@@ -0,0 +1,81 @@
+/**
+ * Checks the disk group requests of an OperatingSystem with a BackingStore
+ * attached: every part of a group request does real file I/O, and the
+ * process that made it must be unblocked once all the parts finished.
+ *
+ * Usage (make check runs it):
+ *     ./iocheck [backing directory]
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ossim.h"
+
+using namespace std;
+
+/**
+ * @os: the operating system, its backing I/O in flight.
+ * @pid: the process that waits for the I/O.
+ *
+ * Reaps the finished I/O until @pid runs again. Returns false if it still
+ * does not after 5 seconds.
+ */
+bool waitUntilRunning(OperatingSystem& os, int pid) {
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::seconds(5);
+
+    while (chrono::steady_clock::now() < deadline) {
+        os.pollDiskCompletions();
+        if (os.runningProcess() == pid) { return true; }
+
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return false;
+}
+
+/**
+ * @name: what is checked, printed with the outcome.
+ * @ok: whether the check passed.
+ *
+ * Returns @ok.
+ */
+bool report(string name, bool ok) {
+    cout << (ok ? "PASS " : "FAIL ") << name << endl;
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    string root = argc > 1 ? argv[1] : "iocheck_backing";
+    bool ok = true;
+
+    BackingStore backing_store{root, 4, 4096, 2};
+    OperatingSystem os{4 * 4096, 4096, 4};
+    os.attachBackingStore(&backing_store);
+
+    int striped = os.addDiskGroup(RAID_0, vector<int>{0, 1});
+    int mirrored = os.addDiskGroup(RAID_1, vector<int>{2, 3});
+
+    os.spawnProcess();
+    int pid = os.runningProcess();
+
+    os.useDisk(striped, "striped", true);
+    ok &= report("backed RAID-0 write unblocks the process", waitUntilRunning(os, pid));
+
+    os.useDisk(striped, "striped", false);
+    ok &= report("backed RAID-0 read unblocks the process", waitUntilRunning(os, pid));
+
+    os.useDisk(mirrored, "mirrored", true);
+    ok &= report("backed RAID-1 write unblocks the process", waitUntilRunning(os, pid));
+
+    os.useDisk(mirrored, "mirrored", false);
+    ok &= report("backed RAID-1 read unblocks the process", waitUntilRunning(os, pid));
+
+    IoSnapshot io = os.snapshotIO();
+    for (size_t i = 0; i < io.disks_.size(); i++) {
+        ok &= report("disk " + to_string(i) + " is idle", io.disks_[i].entries_.empty());
+    }
+
+    return ok ? 0 : 1;
+}
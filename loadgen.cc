@@ -0,0 +1,183 @@
+/**
+ * Load generator for the simulator's server mode (see server.h). Opens a number
+ * of concurrent client connections to the daemon, each one pipelining batches of
+ * commands, and reports the throughput in commands/sec.
+ *
+ * Usage:
+ *     ./loadgen <socket> [clients] [commands per client] [batch size]
+ */
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Struct that holds the results of one client thread.
+ */
+struct ClientResult {
+    long replies_;
+    long errors_;
+    bool failed_;
+
+    ClientResult() : replies_{0}, errors_{0}, failed_{false}
+        { }
+};
+
+/**
+ * @socket_path: path of the daemon's socket.
+ *
+ * Returns a connected socket or -1.
+ */
+int connectTo(string socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { return -1; }
+
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @fd: the connection.
+ * @buffer: bytes received but not consumed yet.
+ * @status: set to the status of the reply.
+ *
+ * Reads one full reply ("<status> <length>\n<payload>"). Returns false if the
+ * connection closed.
+ */
+bool readReply(int fd, string& buffer, string& status) {
+    char chunk[65536];
+    size_t header_end;
+
+    while ((header_end = buffer.find('\n')) == string::npos) {
+        ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count <= 0) { return false; }
+        buffer.append(chunk, count);
+    }
+
+    string header = buffer.substr(0, header_end);
+    size_t space = header.find(' ');
+    status = header.substr(0, space);
+    size_t length = stoul(header.substr(space + 1));
+
+    while (buffer.size() < header_end + 1 + length) {
+        ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count <= 0) { return false; }
+        buffer.append(chunk, count);
+    }
+
+    buffer.erase(0, header_end + 1 + length);
+    return true;
+}
+
+/**
+ * @socket_path: path of the daemon's socket.
+ * @client: index of this client, used to vary the addresses.
+ * @commands: number of commands this client sends.
+ * @batch: number of commands sent before waiting for the replies.
+ * @result: filled with the results.
+ *
+ * Sends a mix of process creation, memory references, preemption and
+ * termination so the simulator state stays bounded during long runs.
+ */
+void runClient(string socket_path, int client, long commands, int batch, ClientResult* result) {
+    int fd = connectTo(socket_path);
+    if (fd < 0) {
+        result->failed_ = true;
+        return;
+    }
+
+    const char* pattern[] = { "A", "m ", "m ", "Q", "m ", "exit" };
+    const int pattern_size = 6;
+    string buffer, status;
+    long sent = 0;
+
+    while (sent < commands) {
+        string requests;
+        int in_batch = 0;
+
+        for (; in_batch < batch && sent < commands; in_batch++, sent++) {
+            string command = pattern[sent % pattern_size];
+            if (command == "m ") {
+                command += to_string((client * 7919 + sent * 4099) % 1000000);
+            }
+            requests += command + "\n";
+        }
+
+        if (send(fd, requests.data(), requests.size(), MSG_NOSIGNAL) != (ssize_t) requests.size()) {
+            result->failed_ = true;
+            break;
+        }
+
+        for (int i = 0; i < in_batch; i++) {
+            if (!readReply(fd, buffer, status)) {
+                result->failed_ = true;
+                close(fd);
+                return;
+            }
+
+            result->replies_++;
+            if (status != "OK") { result->errors_++; }
+        }
+    }
+
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <socket> [clients] [commands per client] [batch size]" << endl;
+        return 1;
+    }
+
+    string socket_path = argv[1];
+    int clients = argc > 2 ? stoi(argv[2]) : 4;
+    long commands = argc > 3 ? stol(argv[3]) : 100000;
+    int batch = argc > 4 ? stoi(argv[4]) : 64;
+
+    vector<ClientResult> results(clients);
+    vector<thread> threads;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (int i = 0; i < clients; i++) {
+        threads.push_back(thread(runClient, socket_path, i, commands, batch, &results[i]));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long replies = 0, errors = 0;
+
+    for (auto &result : results) {
+        if (result.failed_) {
+            cout << "A client lost its connection" << endl;
+        }
+        replies += result.replies_;
+        errors += result.errors_;
+    }
+
+    cout << "Clients: " << clients << ", batch: " << batch << endl;
+    cout << "Commands: " << replies << " (" << errors << " failed)" << endl;
+    cout << "Time: " << seconds << " s" << endl;
+    cout << "Throughput: " << replies / seconds << " commands/sec" << endl;
+
+    return 0;
+}
@@ -6,10 +6,16 @@
 #ifndef MEMORY_TABLE_H
 #define MEMORY_TABLE_H
 
-#include <iomanip>
-#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include "cow_array.h"
+#include "geometry.h"
+#include "swap_area.h"
+
 using namespace std;
 
 /**
@@ -22,13 +28,17 @@ struct MemoryFrame {
     int process_id_;
     int timestamp_;
     bool active_;
+    bool prefetched_;
+    unsigned short remote_refs_;
 
     MemoryFrame() : 
-        page_num_{0}, process_id_{0}, timestamp_{0}, active_{false}
+        page_num_{0}, process_id_{0}, timestamp_{0}, active_{false}, prefetched_{false},
+        remote_refs_{0}
         { }
 
     MemoryFrame(int page_num, int process_id, int timestamp) : 
-        page_num_{page_num}, process_id_{process_id}, timestamp_{timestamp}, active_{true} 
+        page_num_{page_num}, process_id_{process_id}, timestamp_{timestamp}, active_{true},
+        prefetched_{false}, remote_refs_{0}
         { }
 };
 
@@ -36,14 +46,14 @@ struct MemoryFrame {
  * MemoryFrame operator overloads. That are needed for various functions in this class.
  */
 
-bool operator== (MemoryFrame& lhs, MemoryFrame& rhs) {
+inline bool operator== (MemoryFrame& lhs, MemoryFrame& rhs) {
     bool same_page = lhs.page_num_ == rhs.page_num_;
     bool same_pid = lhs.process_id_ == rhs.process_id_;
 
     return (same_page && same_pid);
 }
 
-bool operator < (MemoryFrame& lhs, MemoryFrame& rhs) {
+inline bool operator < (MemoryFrame& lhs, MemoryFrame& rhs) {
     if (!lhs.active_ || !rhs.active_) {
         return false;
     } 
@@ -52,165 +62,1523 @@ bool operator < (MemoryFrame& lhs, MemoryFrame& rhs) {
 }
 
 
-class MemoryTable {
+/**
+ * Where a page fault places its page when the memory has several nodes.
+ * First touch uses the home node of the faulting process, interleave spreads
+ * the pages of every process over the nodes by page number.
+ */
+enum NumaPolicy {
+    NUMA_FIRST_TOUCH,
+    NUMA_INTERLEAVE
+};
+
+/**
+ * Struct that holds the NUMA configuration of a MemoryTable.
+ *
+ * @node_count_: number of nodes the frames are split into.
+ * @policy_: placement of faulted pages.
+ * @local_ns_: modeled cost of a reference to a frame on the process's home node.
+ * @remote_ns_: modeled cost of a reference to a frame on another node.
+ * @migrate_after_: remote references after which a page moves to the home
+ * node of the process using it, 0 to never migrate.
+ */
+struct NumaConfig {
+    int node_count_;
+    NumaPolicy policy_;
+    int local_ns_;
+    int remote_ns_;
+    int migrate_after_;
+
+    NumaConfig() : node_count_{1}, policy_{NUMA_FIRST_TOUCH}, local_ns_{80}, remote_ns_{140},
+        migrate_after_{0}
+        { }
+};
+
+/**
+ * Struct for one node of the memory. A node owns the frames
+ * [@first_frame_, @first_frame_ + @frame_count_) and has its own free list and
+ * replacement scan, so a full node evicts one of its own pages.
+ *
+ * @active_count_: frames of the node in use.
+ * @free_frames_: stack of the node's frames that are not active.
+ * @faults_: page faults that placed their page on this node.
+ * @evictions_: pages of this node replaced to make room.
+ * @migrations_: pages moved to this node from another one.
+ * @local_accesses_: references by processes whose home is this node.
+ * @remote_accesses_: references by processes of other nodes.
+ * @access_time_ns_: modeled time of all the references.
+ */
+struct MemoryNode {
+    int first_frame_;
+    int frame_count_;
+    int active_count_;
+    CowArray<int> free_frames_;
+    long faults_;
+    long evictions_;
+    long migrations_;
+    long local_accesses_;
+    long remote_accesses_;
+    long access_time_ns_;
+
+    MemoryNode() : first_frame_{0}, frame_count_{0}, active_count_{0}, faults_{0}, evictions_{0},
+        migrations_{0}, local_accesses_{0}, remote_accesses_{0}, access_time_ns_{0}
+        { }
+};
+
+/**
+ * Struct for the sequential-access detector of one process. Two page faults
+ * in a row with the same distance (@stride_) between their pages make a
+ * stream, and from then on every fault that continues the stream prefetches
+ * the next @window_ pages of it.
+ *
+ * @last_page_: last page of the stream, faulted or prefetched.
+ * @stride_: distance between the pages of the stream, 0 if none yet.
+ * @window_: pages prefetched per fault, grown and shrunk with the accuracy.
+ * @used_: prefetched pages referenced since @window_ last changed.
+ * @wasted_: prefetched pages evicted or freed unreferenced since then.
+ */
+struct PrefetchStream {
+    int last_page_;
+    int stride_;
+    int window_;
+    int used_;
+    int wasted_;
+
+    PrefetchStream() : last_page_{-1}, stride_{0}, window_{2}, used_{0}, wasted_{0}
+        { }
+};
+
+/**
+ * How the frames are divided between the processes. Proportional gives every
+ * process a share of the frames proportional to its size (its highest page
+ * referenced plus one), priority a share proportional to its priority (see
+ * the 'P' command). Off keeps no per-process bookkeeping at all.
+ */
+enum QuotaPolicy {
+    QUOTA_OFF,
+    QUOTA_PROPORTIONAL,
+    QUOTA_PRIORITY
+};
+
+/**
+ * Where the victim of a page fault comes from. Global replacement takes the
+ * oldest page of the node whoever owns it, so the quotas are only reported.
+ * Local replacement makes a process that reached its quota replace one of its
+ * own pages, so a process streaming through memory cannot push out the pages
+ * of the others.
+ */
+enum ReplacementScope {
+    SCOPE_GLOBAL,
+    SCOPE_LOCAL
+};
+
+/**
+ * Struct that holds the quota configuration of a MemoryTable.
+ */
+struct QuotaConfig {
+    QuotaPolicy policy_;
+    ReplacementScope scope_;
+
+    QuotaConfig() : policy_{QUOTA_OFF}, scope_{SCOPE_GLOBAL}
+        { }
+};
+
+/**
+ * Struct for the resident set of one process. Its frames form a list threaded
+ * through the ResidentLinks of the frames, oldest queued first.
+ *
+ * @priority_: weight of the process with QUOTA_PRIORITY.
+ * @size_: highest page referenced plus one, its weight with QUOTA_PROPORTIONAL.
+ * @resident_: frames holding pages of the process.
+ * @head_: first frame of the list, -1 if it is empty.
+ * @tail_: last frame of the list, -1 if it is empty.
+ * @faults_: page faults of the process.
+ * @own_evictions_: pages the process evicted to make room for its own faults.
+ * @stolen_: pages of the process evicted by the faults of others.
+ */
+struct ResidentSet {
+    int priority_;
+    long size_;
+    int resident_;
+    int head_;
+    int tail_;
+    long faults_;
+    long own_evictions_;
+    long stolen_;
+
+    ResidentSet() : priority_{1}, size_{0}, resident_{0}, head_{-1}, tail_{-1}, faults_{0},
+        own_evictions_{0}, stolen_{0}
+        { }
+};
+
+/**
+ * Struct that links a frame into the resident set of its process.
+ *
+ * @prev_: previous frame of the process, -1 if first.
+ * @next_: next frame of the process, -1 if last.
+ * @queued_at_: timestamp of the frame when it joined the back of the list. A
+ * frame referenced since then gets a second chance instead of being evicted.
+ */
+struct ResidentLink {
+    int prev_;
+    int next_;
+    int queued_at_;
+
+    ResidentLink() : prev_{-1}, next_{-1}, queued_at_{0}
+        { }
+};
+
+/**
+ * Struct for one row of a quota snapshot, see ResidentSet. @references_ is
+ * filled in by the OS, which counts the references of every process.
+ */
+struct ResidentStats {
+    int pid_;
+    int priority_;
+    long size_;
+    int quota_;
+    int resident_;
+    long faults_;
+    long references_;
+    long own_evictions_;
+    long stolen_;
+
+    double faultRate() const {
+        return references_ > 0 ? (double) faults_ / references_ : 0;
+    }
+};
+
+/**
+ * Struct that holds the quota configuration and the resident set of every
+ * process, in pid order.
+ */
+struct QuotaSnapshot {
+    QuotaConfig config_;
+    int frame_count_;
+    vector<ResidentStats> processes_;
+};
+
+/**
+ * Struct for one batched write of dirty pages to the write-back disk.
+ *
+ * @pages_: number of pages written.
+ * @runs_: number of runs of consecutive pages of one process in the batch,
+ * the number of seeks the write needs.
+ */
+struct WriteBack {
+    int pages_;
+    int runs_;
+};
+
+/**
+ * Struct for one row of a memory snapshot. @active_ is false for a frame that
+ * was freed since the previous snapshot, only found in delta snapshots.
+ */
+struct FrameRow {
+    int frame_;
+    int page_;
+    int pid_;
+    int timestamp_;
+    bool active_;
+};
+
+/**
+ * Struct that holds the page fault, prefetch, write-back and swap counters
+ * of a MemoryTable. @swap_ is only filled in when @swap_enabled_.
+ */
+struct SwapSnapshot {
+    long minor_faults_;
+    long major_faults_;
+    long hits_;
+    int prefetch_limit_;
+    long prefetches_;
+    long prefetch_hits_;
+    long prefetch_wasted_;
+    int frame_count_;
+    long dirty_pages_;
+    long dirty_evictions_;
+    int writeback_batch_;
+    int dirty_ratio_;
+    long writeback_pages_;
+    long writeback_writes_;
+    long writeback_runs_;
+    long pending_pages_;
+    long flushed_pages_;
+    bool swap_enabled_;
+    SwapStats swap_;
+};
+
+/**
+ * Struct for the counters of one NUMA node, see MemoryNode.
+ */
+struct NodeStats {
+    int active_count_;
+    int frame_count_;
+    long faults_;
+    long evictions_;
+    long migrations_;
+    long local_accesses_;
+    long remote_accesses_;
+    long access_time_ns_;
+};
+
+/**
+ * Struct that holds the NUMA configuration and the counters of every node.
+ */
+struct NodeSnapshot {
+    NumaConfig numa_;
+    vector<NodeStats> nodes_;
+};
+
+/**
+ * Struct for one stripe of the frame index. A stripe maps the (pid, page#) keys
+ * that hash to it onto their frame number and has its own lock, so references
+ * to pages in different stripes never wait on each other.
+ *
+ * @hits_: references to pages of this stripe that were in memory.
+ */
+struct FrameStripe {
+    mutex mutex_;
+    CowValue<unordered_map<long long, int> > frames_;
+    long hits_;
+
+    FrameStripe() : hits_{0}
+        { }
+};
+
+/**
+ * The MemoryTable can be used from several threads at once. A reference to a
+ * page that is already in memory only locks the stripe of the frame index its
+ * key hashes to. Page faults, which may need to pick a victim out of the whole
+ * table, are serialized by @replacement_mutex_. Lock order is always
+ * @replacement_mutex_ first, then a single stripe.
+ *
+ * The frames are stored in the container picked by the Geometry (see geometry.h),
+ * a CowArray for RuntimeGeometry and a fixed size array for FixedGeometry. The
+ * bitmaps, free frames and frame index are copy-on-write too, so a table can be
+ * branched in constant time.
+ *
+ * The frames are split into NUMA nodes (one unless configureNodes(...) says
+ * otherwise). Node counters touched by hits are updated atomically.
+ *
+ * A write reference sets the dirty bit of its frame. Once write-back is
+ * configured, evicting a dirty page queues it for writing, and the queued pages
+ * are gathered into batches that the OS hands to its write-back disk as one
+ * request each (see flushDirty(...)).
+ *
+ * Once quotas are configured every process has a ResidentSet, and its frames
+ * are linked in the order they were loaded. Hits only refresh the timestamp
+ * as before; a process replacing one of its own pages walks its list with
+ * second chance, moving referenced frames to the back, so the victim is found
+ * in amortized constant time instead of a scan of the node.
+ */
+template <class Geometry>
+class BasicMemoryTable {
     public: 
+        static const int kMaxNodes = 64;
 
         /**
-         * Default Constructor. Won't ever be used.
+         * @geometry: the geometry of the machine, gives the number of entries
+         * that will be allowed into the table.
+         * 
+         * Initialize the frames_ storage to all inactive empty frames.
          */
-        MemoryTable() : frame_limit_{0}, active_count_{0}, memory_time_{0}
-            { }
+        BasicMemoryTable(Geometry geometry) : frame_limit_{geometry.frameCount()},
+            memory_time_{0}, minor_faults_{0}, major_faults_{0}, swap_{nullptr},
+            prefetch_limit_{0}, prefetches_{0}, prefetch_hits_{0}, prefetch_wasted_{0},
+            writeback_batch_{0}, dirty_ratio_{0}, dirty_count_{0}, dirty_evictions_{0},
+            flushed_pages_{0}, writeback_pages_{0}, writeback_writes_{0}, writeback_runs_{0},
+            total_priority_{0}, total_size_{0}, release_epoch_{0}
+            {
+                sizeStorage(frames_, frame_limit_);
+                active_bits_.assign((frame_limit_ + 63) / 64, 0);
+                changed_bits_.assign((frame_limit_ + 63) / 64, 0);
+                dirty_bits_.assign((frame_limit_ + 63) / 64, 0);
+
+                configureNodes(NumaConfig());
+            }
 
         /**
-         * @table_size: The number of entries that will be allowed into the table.
+         * @other: the table that is branched.
          * 
-         * Initialize the frames_ vector to all inactive empty frames.
+         * Makes a table in the same state as @other in constant time: the frames,
+         * the bitmaps, the free frames, the frame index and the resident sets
+         * are shared with @other until either table changes them (see
+         * cow_array.h). The swap area is not shared, the OS only branches
+         * tables that have none.
          */
-        MemoryTable(int table_size) : frame_limit_{table_size}, active_count_{0}, memory_time_{0}
+        explicit BasicMemoryTable(BasicMemoryTable& other) : swap_{nullptr}
             {
-                for (int i = 0; i < frame_limit_; i++) {
-                    frames_.push_back(new MemoryFrame());
+                lock_guard<mutex> replacement(other.replacement_mutex_);
+
+                frames_ = other.frames_;
+                frame_limit_ = other.frame_limit_;
+                memory_time_ = __atomic_load_n(&other.memory_time_, __ATOMIC_RELAXED);
+                minor_faults_ = other.minor_faults_;
+                major_faults_ = other.major_faults_;
+                numa_ = other.numa_;
+                frames_per_node_ = other.frames_per_node_;
+                nodes_ = other.nodes_;
+                prefetch_limit_ = other.prefetch_limit_;
+                prefetches_ = other.prefetches_;
+                prefetch_hits_ = other.prefetch_hits_;
+                prefetch_wasted_ = other.prefetch_wasted_;
+                streams_ = other.streams_;
+                writeback_batch_ = other.writeback_batch_;
+                dirty_ratio_ = other.dirty_ratio_;
+                dirty_count_ = __atomic_load_n(&other.dirty_count_, __ATOMIC_RELAXED);
+                dirty_evictions_ = other.dirty_evictions_;
+                flushed_pages_ = other.flushed_pages_;
+                writeback_pages_ = other.writeback_pages_;
+                writeback_writes_ = other.writeback_writes_;
+                writeback_runs_ = other.writeback_runs_;
+                pending_pages_ = other.pending_pages_;
+                ready_writebacks_ = other.ready_writebacks_;
+                active_bits_ = other.active_bits_;
+                changed_bits_ = other.changed_bits_;
+                dirty_bits_ = other.dirty_bits_;
+                quota_ = other.quota_;
+                residents_ = other.residents_;
+                links_ = other.links_;
+                total_priority_ = other.total_priority_;
+                total_size_ = other.total_size_;
+                release_epoch_ = other.release_epoch_;
+
+                for (int i = 0; i < kStripeCount; i++) {
+                    lock_guard<mutex> lock(other.stripes_[i].mutex_);
+
+                    stripes_[i].frames_ = other.stripes_[i].frames_;
+                    stripes_[i].hits_ = other.stripes_[i].hits_;
                 }
             }
+
+        /**
+         * @config: the NUMA configuration, see NumaConfig above.
+         * 
+         * Splits the frames into @config.node_count_ nodes of the same size,
+         * the last node also gets the frames left over. There are never more
+         * than kMaxNodes nodes, nor more nodes than frames. Must be called
+         * before the first reference.
+         */
+        void configureNodes(NumaConfig config) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+
+            if (config.node_count_ > kMaxNodes) { config.node_count_ = kMaxNodes; }
+            if (config.node_count_ > frame_limit_) { config.node_count_ = frame_limit_; }
+            if (config.node_count_ < 1) { config.node_count_ = 1; }
+            if (config.migrate_after_ > 65535) { config.migrate_after_ = 65535; }
+
+            numa_ = config;
+            frames_per_node_ = frame_limit_ / config.node_count_;
+            nodes_.assign(config.node_count_, MemoryNode());
+
+            for (int n = 0; n < config.node_count_; n++) {
+                MemoryNode &node = nodes_[n];
+
+                node.first_frame_ = n * frames_per_node_;
+                node.frame_count_ = n == config.node_count_ - 1 ? frame_limit_ - node.first_frame_
+                                                                 : frames_per_node_;
+
+                for (int i = node.first_frame_ + node.frame_count_ - 1; i >= node.first_frame_; i--) {
+                    node.free_frames_.push_back(i);
+                }
+            }
+        }
+
+        int nodeCount() const {
+            return numa_.node_count_;
+        }
+
         /**
-         * Destructor that clears all the pointers within the vector.
+         * @max_pages: the most pages a fault may prefetch, 0 to never
+         * prefetch. Never more than half the frames of a node, so a window
+         * cannot push out the page that faulted.
          */
-        ~MemoryTable() {
-            for (auto &frame : frames_) {
-                delete frame;
-                frame = nullptr;
+        void setPrefetchLimit(int max_pages) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+
+            if (max_pages > frames_per_node_ / 2) { max_pages = frames_per_node_ / 2; }
+            prefetch_limit_ = max_pages < 0 ? 0 : max_pages;
+        }
+
+        /**
+         * @batch_pages: dirty pages written by one write-back request, 0 to
+         * turn write-back off.
+         * @dirty_ratio: percentage of the frames that may be dirty before the
+         * flusher starts cleaning the oldest dirty pages.
+         */
+        void configureWriteBack(int batch_pages, int dirty_ratio) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+
+            writeback_batch_ = batch_pages < 0 ? 0 : batch_pages;
+            dirty_ratio_ = dirty_ratio < 0 ? 0 : dirty_ratio;
+        }
+
+        /**
+         * @config: the quota policy and the replacement scope, see QuotaConfig.
+         * Must be called before the first reference.
+         */
+        void configureQuotas(QuotaConfig config) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+
+            quota_ = config;
+            if (config.policy_ != QUOTA_OFF) {
+                links_.assign(frame_limit_, ResidentLink());
             }
         }
 
+        bool quotasEnabled() const {
+            return quota_.policy_ != QUOTA_OFF;
+        }
+
+        /**
+         * @pid: a process that was just made or changed its priority.
+         * @priority: its weight with QUOTA_PRIORITY, at least 1.
+         *
+         * Registers the process so it counts for the quotas before its first
+         * page fault. Does nothing if quotas are off.
+         */
+        void setPriority(int pid, int priority) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+            if (quota_.policy_ == QUOTA_OFF) { return; }
+
+            ResidentSet &set = residentSet(pid);
+            total_priority_ += priority - set.priority_;
+            set.priority_ = priority;
+        }
+
+        /**
+         * @page_num: value of the page number that the process want to load into memeory.
+         * @pid: process identifier.
+         */
+        void insertFrame(int page_num, int pid) {
+            insertFrame(page_num, pid, 0, false);
+        }
+
+        void insertFrame(int page_num, int pid, int home_node) {
+            insertFrame(page_num, pid, home_node, false);
+        }
+
+        void insertFrame(int page_num, int pid, int home_node, bool write) {
+            insertFrame(page_num, pid, home_node, write, releaseEpoch());
+        }
+
+        /**
+         * Returns the number of processes released so far. A caller that
+         * read it while it knew @pid was alive passes it to insertFrame(...),
+         * which refuses the reference if any process was released since.
+         */
+        long releaseEpoch() const {
+            return __atomic_load_n(&release_epoch_, __ATOMIC_ACQUIRE);
+        }
+
         /**
          * @page_num: value of the page number that the process want to load into memeory.
          * @pid: process identifier.
-         * @timestamp: "time" memory is accessed.
+         * @home_node: the NUMA node the process runs on.
+         * @write: true if the process writes the page, which makes it dirty.
          * 
-         * A new MemoryFrame object is created that which may be added to the table if a 
-         * criteria is met.
+         * First we check the frame index to see if the page is already in the table (the pid
+         * and page# are the same.) If true we refresh the frame's timestamp. See @frameInMemory(...)
+         * A page referenced from another node often enough is migrated to @home_node.
          * 
-         * First we check to see if newFrame is already in the table (the pid and page# are
-         * the same.) If true we override the entry in the table with newFrame. See @frameInMemory(...)
+         * Otherwise the reference is a page fault. If the page was swapped out it is read
+         * back from the swap area (a major fault), if not it is a minor fault.
          * 
-         * If the table is full we find the oldest entry in the table and override it with newFrame
-         * object.
+         * The NUMA policy picks the node of the new page. If that node has no free frame
+         * another node with a free frame is used, and if every node is full we find the
+         * oldest entry of the picked node, write its page to the swap area and override
+         * it with the new page.
          * 
-         * If both fail then we find the first available frame and insert our newFrame into the table.
+         * When prefetching is on, a fault that continues a sequential stream of the
+         * process also brings in the next pages of the stream, see prefetchAfter(...).
          * 
+         * @epoch: releaseEpoch() read while @pid was known to be alive. If a
+         * process was released since, @pid may be dead or even handed to a new
+         * process, so nothing is changed and false is returned. The check is
+         * made under the stripe lock for hits and under @replacement_mutex_
+         * for faults, the locks releaseResources(...) takes.
          */
-        void insertFrame(int page_num, int pid) {
-            memory_time_++;
-            MemoryFrame* newFrame = new MemoryFrame(page_num, pid, memory_time_);
-
-            if (frameInMemory(newFrame)) { return; }
-            else if (active_count_ == frame_limit_) {
-                 MemoryFrame* temp = findOldestFrame();
-
-                 temp->page_num_ = page_num;
-                 temp->process_id_ = pid;
-                 temp->timestamp_ = memory_time_;
-                 
-                 return;
-            } else {
-                for (auto &frame : frames_) {
-                    if (!frame->active_) {
-                        frame = newFrame;
-                        active_count_++;
-                        return;
-                    }
+        bool insertFrame(int page_num, int pid, int home_node, bool write, long epoch) {
+            long long key = makeKey(pid, page_num);
+            if (home_node < 0 || home_node >= numa_.node_count_) { home_node = 0; }
+
+            bool first_use = false;
+            int frame_num = frameInMemory(key, first_use, write, epoch);
+            if (frame_num == kStaleReference) { return false; }
+
+            if (frame_num >= 0) {
+                bool migrate = recordAccess(frame_num, home_node);
+
+                if (first_use || migrate) {
+                    lock_guard<mutex> replacement(replacement_mutex_);
+                    if (release_epoch_ != epoch) { return true; }
+
+                    if (first_use) { prefetchUsed(pid); }
+                    if (migrate) { migrateFrame(key, home_node); }
                 }
+                return true;
+            }
+
+            lock_guard<mutex> replacement(replacement_mutex_);
+            if (release_epoch_ != epoch) { return false; }
+
+            /* Another thread may have faulted the same page in while we waited. */
+            frame_num = frameInMemory(key, first_use, write, epoch);
+            if (frame_num >= 0) {
+                recordAccess(frame_num, home_node);
+                if (first_use) { prefetchUsed(pid); }
+                return true;
+            }
+
+            int timestamp = nextTimestamp();
+            frame_num = loadPage(page_num, pid, home_node, timestamp, false);
+            recordAccess(frame_num, home_node);
+            if (write) { markDirty(frame_num); }
+
+            if (prefetch_limit_ > 0) {
+                prefetchAfter(page_num, pid, home_node, timestamp);
             }
+            return true;
         }
 
         /**
-         * Prints all the active MemoryFrames. If a frame is inactive, its entry is
-         * skipped and not printed.
+         * @delta: when true only the frames that changed since the previous
+         * snapshot are returned. Frames that were freed have @active_ false.
+         * 
+         * Returns all the active MemoryFrames in frame order. The active (or
+         * changed) frames are found through a bitmap, so the inactive frames are
+         * never visited one by one.
          */
+        vector<FrameRow> snapshotMemory(bool delta) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+            vector<FrameRow> rows;
 
-        void snapshotMemory() {
-            cout << left << setw(10) << setfill(' ') << "Frame#";
-            cout << left << setw(10) << setfill(' ') << "Page#";
-            cout << left << setw(7) << setfill(' ') << "PID";
-            cout << left << setw(10) << setfill(' ') << "Timestamp" << endl;  
-            cout << left << setw(37) << setfill('=') << "=" << endl;
+            for (size_t word = 0; word < changed_bits_.size(); word++) {
+                unsigned long long changed = 0;
+                if (__atomic_load_n(&changed_bits_[word], __ATOMIC_RELAXED) != 0) {
+                    changed = __atomic_exchange_n(&changed_bits_.edit(word), 0ULL, __ATOMIC_RELAXED);
+                }
+                unsigned long long bits = delta ? changed : active_bits_[word];
 
-            for (int i = 0; i < frame_limit_; i++) {
-                if (!frames_[i]->active_) { continue; }
+                while (bits != 0) {
+                    int frame_num = word * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
 
-                cout << left << "  " << setw(9) << setfill(' ') << i;
-                cout << left << setw(10) << setfill(' ') << frames_[i]->page_num_;
-                cout << left << setw(6) << setfill(' ') << frames_[i]->process_id_;
-                cout << right << setw(5) << setfill(' ') << frames_[i]->timestamp_ << endl;  
+                    const MemoryFrame &frame = frames_[frame_num];
+                    FrameRow row = {frame_num, frame.page_num_, frame.process_id_, timestampOf(frame_num),
+                                    frame.active_};
+                    rows.push_back(row);
+                }
             }
 
-            cout << endl;
+            return rows;
         }
 
         /**
          * @pid: the pid of the function whose resources we are releasing.
          * 
          * Iterate through the entire table and erase all table entries that
-         * have same pid.
+         * have same pid, or only through its resident set when quotas are on.
+         * Pages the process has on the swap area are discarded too, and so
+         * are its dirty pages: nobody will read them again.
          */
         void releaseResources(int pid) {
-            for (int i = 0; i < frame_limit_; i++) {
-                if (frames_[i]->process_id_ == pid) {
-                    frames_[i]->active_ = false;
-                    active_count_--;
+            lock_guard<mutex> replacement(replacement_mutex_);
+            __atomic_add_fetch(&release_epoch_, 1, __ATOMIC_RELEASE);
+
+            if (quota_.policy_ != QUOTA_OFF) {
+                releaseResidentSet(pid);
+            } else {
+                for (int i = 0; i < frame_limit_; i++) {
+                    if (frames_[i].active_ && frames_[i].process_id_ == pid) {
+                        releaseFrame(i);
+                    }
                 }
             }
+
+            if (streams_->count(pid) != 0) { streams_.edit().erase(pid); }
+
+            if (swap_ != nullptr) {
+                swap_->releaseResources(pid);
+            }
+        }
+
+        /**
+         * @swap: the swap area evicted pages are written to.
+         */
+        void attachSwap(SwapArea* swap) {
+            swap_ = swap;
+        }
+
+        bool hasSwap() const {
+            return swap_ != nullptr;
+        }
+
+        /**
+         * @close_partial: true to also close the batch being gathered even if
+         * it is not full, so evicted pages do not wait for more evictions forever.
+         * @batches: receives the batches that are ready to be written.
+         * 
+         * The background flusher. While more of the frames than the dirty ratio
+         * are dirty, every call cleans up to a batch of the oldest dirty pages;
+         * the pages stay in memory but their next eviction costs nothing. Called
+         * by the OS once per tick.
+         */
+        void flushDirty(bool close_partial, vector<WriteBack>& batches) {
+            lock_guard<mutex> replacement(replacement_mutex_);
+            if (writeback_batch_ == 0) { return; }
+
+            long dirty = __atomic_load_n(&dirty_count_, __ATOMIC_RELAXED);
+            if (dirty * 100 > (long) dirty_ratio_ * frame_limit_) {
+                cleanOldest();
+                close_partial = true;
+            }
+
+            if (close_partial) { closeBatch(); }
+            batches.swap(ready_writebacks_);
+        }
+
+        /**
+         * Returns the page fault, prefetch and write-back counters and the
+         * state of the swap area.
+         */
+        SwapSnapshot snapshotSwap() {
+            lock_guard<mutex> replacement(replacement_mutex_);
+            SwapSnapshot snapshot;
+
+            snapshot.hits_ = 0;
+            for (int i = 0; i < kStripeCount; i++) {
+                lock_guard<mutex> lock(stripes_[i].mutex_);
+                snapshot.hits_ += stripes_[i].hits_;
+            }
+
+            snapshot.minor_faults_ = minor_faults_;
+            snapshot.major_faults_ = major_faults_;
+            snapshot.prefetch_limit_ = prefetch_limit_;
+            snapshot.prefetches_ = prefetches_;
+            snapshot.prefetch_hits_ = prefetch_hits_;
+            snapshot.prefetch_wasted_ = prefetch_wasted_;
+            snapshot.frame_count_ = frame_limit_;
+            snapshot.dirty_pages_ = __atomic_load_n(&dirty_count_, __ATOMIC_RELAXED);
+            snapshot.dirty_evictions_ = dirty_evictions_;
+            snapshot.writeback_batch_ = writeback_batch_;
+            snapshot.dirty_ratio_ = dirty_ratio_;
+            snapshot.writeback_pages_ = writeback_pages_;
+            snapshot.writeback_writes_ = writeback_writes_;
+            snapshot.writeback_runs_ = writeback_runs_;
+            snapshot.pending_pages_ = pending_pages_.size();
+            snapshot.flushed_pages_ = flushed_pages_;
+            snapshot.swap_enabled_ = swap_ != nullptr;
+            if (swap_ != nullptr) { snapshot.swap_ = swap_->getStats(); }
+
+            return snapshot;
+        }
+
+        /**
+         * Returns the placement policy and the fault, eviction, migration and
+         * access counters of every NUMA node.
+         */
+        NodeSnapshot snapshotNodes() {
+            lock_guard<mutex> replacement(replacement_mutex_);
+            NodeSnapshot snapshot;
+
+            snapshot.numa_ = numa_;
+            for (int n = 0; n < numa_.node_count_; n++) {
+                MemoryNode &node = nodes_[n];
+                NodeStats stats = {node.active_count_, node.frame_count_, node.faults_, node.evictions_,
+                                   node.migrations_,
+                                   __atomic_load_n(&node.local_accesses_, __ATOMIC_RELAXED),
+                                   __atomic_load_n(&node.remote_accesses_, __ATOMIC_RELAXED),
+                                   __atomic_load_n(&node.access_time_ns_, __ATOMIC_RELAXED)};
+
+                snapshot.nodes_.push_back(stats);
+            }
+
+            return snapshot;
+        }
+
+        /**
+         * Returns the quota configuration and the quota, resident frames,
+         * faults and evictions of every process, in pid order. The references
+         * of the processes are left 0, the OS counts them.
+         */
+        QuotaSnapshot snapshotQuotas() {
+            lock_guard<mutex> replacement(replacement_mutex_);
+            QuotaSnapshot snapshot;
+
+            snapshot.config_ = quota_;
+            snapshot.frame_count_ = frame_limit_;
+            for (auto &entry : *residents_) {
+                const ResidentSet &set = entry.second;
+                ResidentStats stats = {entry.first, set.priority_, set.size_, quotaOf(set), set.resident_,
+                                       set.faults_, 0, set.own_evictions_, set.stolen_};
+
+                snapshot.processes_.push_back(stats);
+            }
+
+            sort(snapshot.processes_.begin(), snapshot.processes_.end(),
+                 [](const ResidentStats& lhs, const ResidentStats& rhs) { return lhs.pid_ < rhs.pid_; });
+            return snapshot;
         }
 
     private: 
+        static const int kStripeCount = 64;
 
         /**
-         * @frames_: vector that will hold all of the MemoryFrames.
+         * Returned by frameInMemory(...) when a process was released since the
+         * reference was made.
+         */
+        static const int kStaleReference = -2;
+
+        /**
+         * @frames_: storage that will hold all of the MemoryFrames.
          * @frame_limit_: the total size of the table
-         * @active_count_: the number of entries used in the table.
          * @memory_time: Number that will be incremented everytime a frame is
-         * inserted. Will be used for the timestape of the table.
+         * referenced. Will be used for the timestape of the table.
+         * @minor_faults_: faults for pages that were never swapped out.
+         * @major_faults_: faults for pages that had to be read from @swap_.
+         * @swap_: the swap area, nullptr if swapping is disabled.
+         * @numa_: the NUMA configuration.
+         * @frames_per_node_: frames of every node but the last.
+         * @nodes_: the NUMA nodes, each with its own free frames and counters.
+         * @prefetch_limit_: the most pages a fault prefetches, 0 if prefetching is off.
+         * @prefetches_: pages brought in by prefetching.
+         * @prefetch_hits_: prefetched pages that were referenced.
+         * @prefetch_wasted_: prefetched pages evicted or freed unreferenced.
+         * @streams_: the sequential-access detector of every process.
+         * @writeback_batch_: most pages in one write-back request, 0 if write-back is off.
+         * @dirty_ratio_: percentage of dirty frames above which the flusher runs.
+         * @dirty_count_: frames whose dirty bit is set.
+         * @dirty_evictions_: dirty pages that were evicted.
+         * @flushed_pages_: dirty pages cleaned by the flusher while in memory.
+         * @writeback_pages_: pages put in write-back requests.
+         * @writeback_writes_: write-back requests made.
+         * @writeback_runs_: runs of consecutive pages in those requests.
+         * @pending_pages_: keys of the pages of the batch being gathered.
+         * @ready_writebacks_: full batches not yet taken by the OS.
+         * @stripes_: the frame index, split into independently locked stripes.
+         * @replacement_mutex_: serializes page faults and everything that scans
+         * the whole table.
+         * @active_bits_: one bit per frame, set while the frame is active.
+         * @changed_bits_: one bit per frame, set when the frame changed since the
+         * last snapshot.
+         * @dirty_bits_: one bit per frame, the dirty bit, set when the page was
+         * written since it was loaded or last cleaned.
+         * @quota_: how the frames are divided between the processes.
+         * @residents_: the resident set of every process, empty if quotas are off.
+         * @links_: one ResidentLink per frame, empty if quotas are off.
+         * @total_priority_: sum of the priorities of the resident sets.
+         * @total_size_: sum of the sizes of the resident sets.
+         * @release_epoch_: number of times releaseResources(...) was called.
          */
-        vector<MemoryFrame*> frames_;
+        typename Geometry::template Storage<MemoryFrame>::Frames frames_;
         int frame_limit_;
-        int active_count_;
         int memory_time_;
+        long minor_faults_;
+        long major_faults_;
+        SwapArea* swap_;
+        NumaConfig numa_;
+        int frames_per_node_;
+        vector<MemoryNode> nodes_;
+        int prefetch_limit_;
+        long prefetches_;
+        long prefetch_hits_;
+        long prefetch_wasted_;
+        CowValue<unordered_map<int, PrefetchStream> > streams_;
+        int writeback_batch_;
+        int dirty_ratio_;
+        long dirty_count_;
+        long dirty_evictions_;
+        long flushed_pages_;
+        long writeback_pages_;
+        long writeback_writes_;
+        long writeback_runs_;
+        vector<long long> pending_pages_;
+        vector<WriteBack> ready_writebacks_;
+        FrameStripe stripes_[kStripeCount];
+        mutex replacement_mutex_;
+        CowArray<unsigned long long> active_bits_;
+        CowArray<unsigned long long> changed_bits_;
+        CowArray<unsigned long long> dirty_bits_;
+        QuotaConfig quota_;
+        CowValue<unordered_map<int, ResidentSet> > residents_;
+        CowArray<ResidentLink> links_;
+        long total_priority_;
+        long total_size_;
+        long release_epoch_;
+
+        static long long makeKey(int pid, int page_num) {
+            return ((long long) pid << 32) | (unsigned int) page_num;
+        }
+
+        FrameStripe& stripeOf(long long key) {
+            unsigned long long hash = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+            return stripes_[hash >> 58];
+        }
+
+        int nextTimestamp() {
+            return __atomic_add_fetch(&memory_time_, 1, __ATOMIC_RELAXED);
+        }
+
+        int timestampOf(int frame_num) {
+            return __atomic_load_n(&frames_[frame_num].timestamp_, __ATOMIC_RELAXED);
+        }
 
         /**
-         * A new MemoryFrame pointer is assigned to the first entry in the table
-         * Then iterate through the entire table to find the smallest timestamp in 
-         * the table.
+         * @node: the node whose frames are searched.
+         * @protect_from: prefetched frames stamped at or after this time
+         * are not preferred.
+         * 
+         * Iterate through the frames of @node to find the frame with the smallest
+         * timestamp. Prefetched pages that were never referenced and are older
+         * than @protect_from go first. Caller must hold @replacement_mutex_.
          */
-        MemoryFrame* findOldestFrame() {
-            MemoryFrame* temp = frames_[0];
+        int findOldestFrame(const MemoryNode& node, int protect_from) {
+            int end = node.first_frame_ + node.frame_count_;
+            int oldest = node.first_frame_;
+            int oldest_time = timestampOf(oldest);
+            int oldest_prefetched = -1;
+            int prefetched_time = 0;
+
+            for (int i = oldest; i < end; ) {
+                size_t length;
+                const MemoryFrame* frame = readRun(frames_, i, length);
+                int run_end = end - i < (long) length ? end : i + (int) length;
+
+                for (; i < run_end; i++, frame++) {
+                    int timestamp = __atomic_load_n(&frame->timestamp_, __ATOMIC_RELAXED);
 
-            for (auto &frame : frames_) {
-                if (frame->timestamp_ < temp->timestamp_) {
-                    temp = frame;
+                    if (timestamp < oldest_time) {
+                        oldest = i;
+                        oldest_time = timestamp;
+                    }
+
+                    if (__atomic_load_n(&frame->prefetched_, __ATOMIC_RELAXED) && timestamp < protect_from &&
+                        (oldest_prefetched < 0 || timestamp < prefetched_time)) {
+                        oldest_prefetched = i;
+                        prefetched_time = timestamp;
+                    }
                 }
             }
 
-            return temp;
+            return oldest_prefetched >= 0 ? oldest_prefetched : oldest;
         }
 
+        /**
+         * @page_num: page brought into memory.
+         * @pid: process that owns the page.
+         * @home_node: node of the process.
+         * @timestamp: the time stamped on the frame.
+         * @prefetched: true if the page is prefetched instead of referenced.
+         * 
+         * Places the page with the NUMA policy, reading it back from the swap
+         * area if it was swapped out, and indexes it. Returns its frame. With
+         * local replacement a process that reached its quota replaces one of
+         * its own pages instead, wherever it is. Caller must hold
+         * @replacement_mutex_.
+         */
+        int loadPage(int page_num, int pid, int home_node, int timestamp, bool prefetched) {
+            long long key = makeKey(pid, page_num);
+
+            if (swap_ != nullptr && swap_->swapIn(pid, page_num)) {
+                if (!prefetched) { major_faults_++; }
+            } else if (!prefetched) {
+                minor_faults_++;
+            }
+
+            int node;
+            int frame_num = -1;
+
+            if (quota_.policy_ != QUOTA_OFF) {
+                frame_num = chargeFault(pid, page_num, prefetched);
+            }
+
+            if (frame_num >= 0) {
+                node = nodeOf(frame_num);
+                evictFrame(frame_num, pid);
+            } else {
+                node = placementNode(page_num, home_node);
+                frame_num = takeFrame(node, timestamp, pid);
+            }
+            if (!prefetched) { nodes_[node].faults_++; }
+
+            MemoryFrame* frame = &editable(frames_, frame_num);
+            frame->page_num_ = page_num;
+            frame->process_id_ = pid;
+            frame->active_ = true;
+            frame->prefetched_ = prefetched;
+            frame->remote_refs_ = 0;
+            __atomic_store_n(&frame->timestamp_, prefetched ? nextTimestamp() : timestamp, __ATOMIC_RELAXED);
+            active_bits_.edit(frame_num / 64) |= 1ULL << (frame_num % 64);
+            markChanged(frame_num);
+            if (quota_.policy_ != QUOTA_OFF) { linkResident(pid, frame_num); }
+
+            FrameStripe &stripe = stripeOf(key);
+            lock_guard<mutex> lock(stripe.mutex_);
+            stripe.frames_.edit()[key] = frame_num;
+
+            return frame_num;
+        }
 
         /**
-         * @frame: the MemoryFrame we wish to see is in memory.
+         * @page_num: the page that just faulted.
+         * @pid: the process that faulted.
+         * @home_node: node of the process.
+         * @timestamp: time of the fault.
          * 
-         * Iterate through table and see if there is an entry equal
-         * to @frame.
+         * Feeds the fault to the stream detector of the process. If the fault
+         * continues the stream, the window is adapted to how many of the
+         * settled prefetches were used (doubled at 75% or more, halved below
+         * 50%) and the next pages of the stream that are not in memory are
+         * prefetched. With local replacement prefetching stops once the process
+         * reaches its quota, so it never replaces the page that just faulted or
+         * another page of its own. Caller must hold @replacement_mutex_.
          */
-        bool frameInMemory(MemoryFrame* frame) {
-            for (auto &f : frames_) {
-                if (*f == *frame && f->active_) {
-                    f = frame;
-                    return true;
+        void prefetchAfter(int page_num, int pid, int home_node, int timestamp) {
+            PrefetchStream &stream = streams_.edit()[pid];
+            long stride = (long) page_num - stream.last_page_;
+
+            if (stream.last_page_ < 0 || stride == 0 || stride != stream.stride_) {
+                stream.stride_ = stream.last_page_ < 0 ? 0 : (int) stride;
+                stream.last_page_ = page_num;
+                return;
+            }
+
+            int settled = stream.used_ + stream.wasted_;
+            if (settled >= stream.window_) {
+                if (stream.used_ * 4 >= settled * 3) {
+                    stream.window_ = stream.window_ * 2;
+                } else if (stream.used_ * 2 < settled) {
+                    stream.window_ = stream.window_ / 2;
                 }
+                stream.used_ = 0;
+                stream.wasted_ = 0;
+            }
+            if (stream.window_ > prefetch_limit_) { stream.window_ = prefetch_limit_; }
+            if (stream.window_ < 1) { stream.window_ = 1; }
+
+            stream.last_page_ = page_num;
+            long page = page_num;
+            for (int i = 0; i < stream.window_; i++) {
+                page += stream.stride_;
+                if (page < 0 || page > INT_MAX) { break; }
+
+                stream.last_page_ = (int) page;
+                if (lookupFrame(makeKey(pid, (int) page)) >= 0) { continue; }
+                if (replacesOwnPage(pid)) { break; }
+
+                loadPage((int) page, pid, home_node, timestamp, true);
+                prefetches_++;
+            }
+        }
+
+        /**
+         * @pid: process that referenced one of its prefetched pages for the
+         * first time. Caller must hold @replacement_mutex_.
+         */
+        void prefetchUsed(int pid) {
+            prefetch_hits_++;
+
+            if (streams_->count(pid) != 0) { streams_.edit()[pid].used_++; }
+        }
+
+        int nodeOf(int frame_num) const {
+            int node = frame_num / frames_per_node_;
+            return node < numa_.node_count_ ? node : numa_.node_count_ - 1;
+        }
+
+        /**
+         * @page_num: the page that faulted.
+         * @home_node: the node of the faulting process.
+         * 
+         * Returns the node the policy picks, or the next node with a free frame
+         * if the picked one is full. Returns the picked node if all are full.
+         */
+        int placementNode(int page_num, int home_node) {
+            int count = numa_.node_count_;
+            int target = numa_.policy_ == NUMA_INTERLEAVE ? (int) ((unsigned int) page_num % count)
+                                                          : home_node;
+
+            for (int i = 0; i < count; i++) {
+                int node = (target + i) % count;
+                if (!nodes_[node].free_frames_.empty()) { return node; }
+            }
+
+            return target;
+        }
+
+        /**
+         * @node_num: node a frame is needed on.
+         * @now: time of the fault the frame is needed for.
+         * @pid: the process the frame is for.
+         * 
+         * Returns a free frame of the node, or evicts the node's oldest page
+         * and returns its frame. A prefetched page
+         * is evicted ahead of the others once it went unused for half as many
+         * references as the node has frames, so a stream's window is not thrown
+         * out by other faults before the stream reaches it. Caller must hold
+         * @replacement_mutex_.
+         */
+        int takeFrame(int node_num, int now, int pid) {
+            MemoryNode &node = nodes_[node_num];
+
+            if (!node.free_frames_.empty()) {
+                int frame_num = node.free_frames_.back();
+                node.free_frames_.pop_back();
+                node.active_count_++;
+
+                return frame_num;
             }
 
-            return false;
+            int frame_num = findOldestFrame(node, now - node.frame_count_ / 2);
+            evictFrame(frame_num, pid);
+
+            return frame_num;
         }
 
+        /**
+         * @frame_num: active frame whose page is evicted.
+         * @pid: the process the frame is taken for.
+         * 
+         * Unindexes the page, writes it to the swap area and queues it for
+         * write-back if it is dirty. The frame stays taken, ready for the
+         * page of @pid. Caller must hold @replacement_mutex_.
+         */
+        void evictFrame(int frame_num, int pid) {
+            MemoryNode &node = nodes_[nodeOf(frame_num)];
+            const MemoryFrame* temp = &frames_[frame_num];
+
+            unindexFrame(makeKey(temp->process_id_, temp->page_num_));
+
+            if (temp->prefetched_) {
+                prefetch_wasted_++;
+
+                if (streams_->count(temp->process_id_) != 0) { streams_.edit()[temp->process_id_].wasted_++; }
+            }
+
+            if (swap_ != nullptr) {
+                swap_->swapOut(temp->process_id_, temp->page_num_);
+            }
+            node.evictions_++;
+
+            if (clearDirty(frame_num)) {
+                dirty_evictions_++;
+                if (writeback_batch_ > 0) { queueWriteBack(makeKey(temp->process_id_, temp->page_num_)); }
+            }
+
+            if (quota_.policy_ != QUOTA_OFF) {
+                ResidentSet &owner = residentSet(temp->process_id_);
+
+                if (temp->process_id_ == pid) {
+                    owner.own_evictions_++;
+                } else {
+                    owner.stolen_++;
+                }
+                unlinkResident(temp->process_id_, frame_num);
+            }
+        }
+
+        /**
+         * @frame_num: active frame that goes back to its node's free frames.
+         * Caller must hold @replacement_mutex_ and have unindexed the frame.
+         */
+        void freeFrame(int frame_num) {
+            MemoryNode &node = nodes_[nodeOf(frame_num)];
+
+            if (quota_.policy_ != QUOTA_OFF) { unlinkResident(frames_[frame_num].process_id_, frame_num); }
+
+            MemoryFrame &frame = editable(frames_, frame_num);
+
+            frame.active_ = false;
+            frame.prefetched_ = false;
+            clearDirty(frame_num);
+            active_bits_.edit(frame_num / 64) &= ~(1ULL << (frame_num % 64));
+            markChanged(frame_num);
+            node.free_frames_.push_back(frame_num);
+            node.active_count_--;
+        }
+
+        /**
+         * @frame_num: frame that was just referenced.
+         * @home_node: node of the process that referenced it.
+         * 
+         * Counts the reference as local or remote on the frame's node. Returns
+         * true when the page has been referenced remotely often enough to be
+         * migrated.
+         */
+        bool recordAccess(int frame_num, int home_node) {
+            int node_num = nodeOf(frame_num);
+            MemoryNode &node = nodes_[node_num];
+
+            if (node_num == home_node) {
+                __atomic_fetch_add(&node.local_accesses_, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&node.access_time_ns_, numa_.local_ns_, __ATOMIC_RELAXED);
+                return false;
+            }
+
+            __atomic_fetch_add(&node.remote_accesses_, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&node.access_time_ns_, numa_.remote_ns_, __ATOMIC_RELAXED);
+
+            if (numa_.migrate_after_ == 0) { return false; }
+
+            unsigned short refs = __atomic_add_fetch(&editable(frames_, frame_num).remote_refs_, 1,
+                                                     __ATOMIC_RELAXED);
+            return refs >= numa_.migrate_after_;
+        }
+
+        /**
+         * @key: the (pid, page#) key of a page on a remote node.
+         * @home_node: the node the page moves to.
+         * 
+         * Takes a frame on @home_node (evicting its oldest page if it is full),
+         * moves the page there and frees the old frame. Nothing happens if the
+         * page was evicted or migrated by someone else in the meantime. Caller
+         * must hold @replacement_mutex_.
+         */
+        void migrateFrame(long long key, int home_node) {
+            int old_frame = lookupFrame(key);
+            if (old_frame < 0 || nodeOf(old_frame) == home_node) { return; }
+
+            int pid = (int) (key >> 32);
+            int frame_num = takeFrame(home_node, __atomic_load_n(&memory_time_, __ATOMIC_RELAXED) + 1, pid);
+            MemoryFrame* frame = &editable(frames_, frame_num);
+
+            *frame = frames_[old_frame];
+            frame->remote_refs_ = 0;
+            active_bits_.edit(frame_num / 64) |= 1ULL << (frame_num % 64);
+            markChanged(frame_num);
+            if (quota_.policy_ != QUOTA_OFF) { linkResident(pid, frame_num); }
+            nodes_[home_node].migrations_++;
+            if (clearDirty(old_frame)) { markDirty(frame_num); }
+
+            {
+                FrameStripe &stripe = stripeOf(key);
+                lock_guard<mutex> lock(stripe.mutex_);
+                stripe.frames_.edit()[key] = frame_num;
+            }
+
+            freeFrame(old_frame);
+        }
+
+        /**
+         * @key: the (pid, page#) key we wish to see is in memory.
+         * @first_use: set to true if the page was prefetched and this is its
+         * first reference.
+         * @write: true to set the frame's dirty bit.
+         * @epoch: see insertFrame(...).
+         * 
+         * Looks @key up in its stripe of the frame index. If the page is in
+         * memory its frame's timestamp is refreshed and its frame number is
+         * returned, otherwise -1, or kStaleReference if a process was released
+         * after @epoch. The dirty bit is set under the stripe lock so the frame
+         * cannot be evicted in between.
+         */
+        int frameInMemory(long long key, bool& first_use, bool write, long epoch) {
+            FrameStripe &stripe = stripeOf(key);
+            lock_guard<mutex> lock(stripe.mutex_);
+
+            if (releaseEpoch() != epoch) { return kStaleReference; }
+
+            unordered_map<long long, int>::const_iterator itr = stripe.frames_->find(key);
+            if (itr == stripe.frames_->end()) { return -1; }
+
+            MemoryFrame* frame = &editable(frames_, itr->second);
+            __atomic_store_n(&frame->timestamp_, nextTimestamp(), __ATOMIC_RELAXED);
+            markChanged(itr->second);
+            stripe.hits_++;
+            if (write) { markDirty(itr->second); }
+
+            first_use = __atomic_load_n(&frame->prefetched_, __ATOMIC_RELAXED) &&
+                        __atomic_exchange_n(&frame->prefetched_, false, __ATOMIC_RELAXED);
+            return itr->second;
+        }
+
+        /**
+         * @key: the (pid, page#) key looked up without counting a reference.
+         * 
+         * Returns the frame holding the page, -1 if it is not in memory.
+         */
+        int lookupFrame(long long key) {
+            FrameStripe &stripe = stripeOf(key);
+            lock_guard<mutex> lock(stripe.mutex_);
+
+            unordered_map<long long, int>::const_iterator itr = stripe.frames_->find(key);
+            return itr == stripe.frames_->end() ? -1 : itr->second;
+        }
+
+        /**
+         * @frame_num: frame whose row will show up in the next delta snapshot.
+         * Hits only hold a stripe lock so the bit is set atomically, and only
+         * when it is not set already.
+         */
+        void markChanged(int frame_num) {
+            unsigned long long bit = 1ULL << (frame_num % 64);
+
+            if ((__atomic_load_n(&changed_bits_[frame_num / 64], __ATOMIC_RELAXED) & bit) == 0) {
+                __atomic_fetch_or(&changed_bits_.edit(frame_num / 64), bit, __ATOMIC_RELAXED);
+            }
+        }
+
+        /**
+         * @frame_num: frame whose page was written. The bit is set atomically
+         * since hits only hold a stripe lock.
+         */
+        void markDirty(int frame_num) {
+            unsigned long long bit = 1ULL << (frame_num % 64);
+
+            if ((__atomic_load_n(&dirty_bits_[frame_num / 64], __ATOMIC_RELAXED) & bit) != 0) { return; }
+            if ((__atomic_fetch_or(&dirty_bits_.edit(frame_num / 64), bit, __ATOMIC_RELAXED) & bit) == 0) {
+                __atomic_fetch_add(&dirty_count_, 1, __ATOMIC_RELAXED);
+            }
+        }
+
+        /**
+         * @frame_num: frame whose dirty bit is cleared.
+         * 
+         * Returns true if the page was dirty.
+         */
+        bool clearDirty(int frame_num) {
+            unsigned long long bit = 1ULL << (frame_num % 64);
+
+            if ((__atomic_load_n(&dirty_bits_[frame_num / 64], __ATOMIC_RELAXED) & bit) == 0 ||
+                (__atomic_fetch_and(&dirty_bits_.edit(frame_num / 64), ~bit, __ATOMIC_RELAXED) & bit) == 0) {
+                return false;
+            }
+
+            __atomic_fetch_sub(&dirty_count_, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+
+        /**
+         * @key: the (pid, page#) key of a dirty page that must be written.
+         * 
+         * Adds the page to the batch being gathered and closes the batch once
+         * it is full. Caller must hold @replacement_mutex_.
+         */
+        void queueWriteBack(long long key) {
+            pending_pages_.push_back(key);
+
+            if ((int) pending_pages_.size() >= writeback_batch_) {
+                closeBatch();
+            }
+        }
+
+        /**
+         * Turns the pages gathered so far into one write-back request. The
+         * pages are sorted so the pages of a process that follow each other
+         * are written as one run. Caller must hold @replacement_mutex_.
+         */
+        void closeBatch() {
+            if (pending_pages_.empty()) { return; }
+
+            sort(pending_pages_.begin(), pending_pages_.end());
+
+            WriteBack batch = {(int) pending_pages_.size(), 1};
+            for (size_t i = 1; i < pending_pages_.size(); i++) {
+                if (pending_pages_[i] != pending_pages_[i - 1] + 1) { batch.runs_++; }
+            }
+
+            ready_writebacks_.push_back(batch);
+            writeback_pages_ += batch.pages_;
+            writeback_writes_++;
+            writeback_runs_ += batch.runs_;
+            pending_pages_.clear();
+        }
+
+        /**
+         * Cleans the oldest dirty pages, as many as fit in the batch being
+         * gathered, and queues them for write-back. Only the dirty frames are
+         * visited, through @dirty_bits_. Caller must hold @replacement_mutex_.
+         */
+        void cleanOldest() {
+            vector<pair<int, int> > dirty;
+
+            for (size_t word = 0; word < dirty_bits_.size(); word++) {
+                unsigned long long bits = __atomic_load_n(&dirty_bits_[word], __ATOMIC_RELAXED);
+
+                while (bits != 0) {
+                    int frame_num = word * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+
+                    dirty.push_back(make_pair(timestampOf(frame_num), frame_num));
+                }
+            }
+
+            size_t count = writeback_batch_ - pending_pages_.size();
+            if (count > dirty.size()) { count = dirty.size(); }
+            partial_sort(dirty.begin(), dirty.begin() + count, dirty.end());
+
+            for (size_t i = 0; i < count; i++) {
+                int frame_num = dirty[i].second;
+                if (!clearDirty(frame_num)) { continue; }
+
+                flushed_pages_++;
+                queueWriteBack(makeKey(frames_[frame_num].process_id_, frames_[frame_num].page_num_));
+            }
+        }
+
+        /**
+         * @frame_num: active frame of a process that is terminated. Caller
+         * must hold @replacement_mutex_.
+         */
+        void releaseFrame(int frame_num) {
+            if (__atomic_load_n(&frames_[frame_num].prefetched_, __ATOMIC_RELAXED)) { prefetch_wasted_++; }
+
+            unindexFrame(makeKey(frames_[frame_num].process_id_, frames_[frame_num].page_num_));
+            freeFrame(frame_num);
+        }
+
+        /**
+         * @pid: process that is terminated.
+         * 
+         * Frees the frames of its resident set, in time proportional to the
+         * number of frames it has, and forgets the set. Caller must hold
+         * @replacement_mutex_.
+         */
+        void releaseResidentSet(int pid) {
+            if (residents_->count(pid) == 0) { return; }
+
+            while (residents_->at(pid).head_ >= 0) {
+                releaseFrame(residents_->at(pid).head_);
+            }
+
+            total_priority_ -= residents_->at(pid).priority_;
+            total_size_ -= residents_->at(pid).size_;
+            residents_.edit().erase(pid);
+        }
+
+        /**
+         * @pid: process whose resident set is returned, made with priority 1
+         * if it has none yet. Caller must hold @replacement_mutex_.
+         */
+        ResidentSet& residentSet(int pid) {
+            unordered_map<int, ResidentSet> &residents = residents_.edit();
+            unordered_map<int, ResidentSet>::iterator itr = residents.find(pid);
+
+            if (itr == residents.end()) {
+                itr = residents.insert(make_pair(pid, ResidentSet())).first;
+                total_priority_ += itr->second.priority_;
+            }
+            return itr->second;
+        }
+
+        /**
+         * @set: resident set whose quota is returned.
+         * 
+         * Returns its share of the frames by priority or by size, at least 1.
+         */
+        int quotaOf(const ResidentSet& set) const {
+            bool by_priority = quota_.policy_ == QUOTA_PRIORITY;
+            long weight = by_priority ? set.priority_ : set.size_;
+            long total = by_priority ? total_priority_ : total_size_;
+            long quota = total > 0 ? (long) frame_limit_ * weight / total : frame_limit_;
+
+            return quota < 1 ? 1 : (int) quota;
+        }
+
+        /**
+         * @pid: process that faulted.
+         * @page_num: the page that is loaded.
+         * @prefetched: true if the page is prefetched instead of referenced.
+         * 
+         * Counts the fault and grows the size of the process. Returns the
+         * frame the process must replace, or -1 if it may take a frame like
+         * with global replacement: the scope is global or the process is below
+         * its quota. The victim is the first frame of its list that was not
+         * referenced since it was queued; referenced frames are moved to the
+         * back with a second chance, at most one pass over the list. Caller
+         * must hold @replacement_mutex_.
+         */
+        int chargeFault(int pid, int page_num, bool prefetched) {
+            ResidentSet &set = residentSet(pid);
+
+            if (!prefetched) { set.faults_++; }
+            if ((long) page_num + 1 > set.size_) {
+                total_size_ += (long) page_num + 1 - set.size_;
+                set.size_ = (long) page_num + 1;
+            }
+
+            if (!replacesOwnPage(pid)) { return -1; }
+
+            for (int turns = set.resident_; turns > 0; turns--) {
+                int frame_num = set.head_;
+                if (timestampOf(frame_num) <= links_[frame_num].queued_at_) { break; }
+
+                unlinkResident(pid, frame_num);
+                linkResident(pid, frame_num);
+            }
+
+            return set.head_;
+        }
+
+        /**
+         * Returns whether the next page of @pid replaces one of its own pages:
+         * the scope is local and the process reached its quota.
+         */
+        bool replacesOwnPage(int pid) {
+            if (quota_.policy_ == QUOTA_OFF || quota_.scope_ != SCOPE_LOCAL) { return false; }
+
+            ResidentSet &set = residentSet(pid);
+            return set.resident_ > 0 && set.resident_ >= quotaOf(set);
+        }
+
+        /**
+         * @pid: process that owns the page of @frame_num.
+         * @frame_num: frame appended to the resident set of @pid.
+         */
+        void linkResident(int pid, int frame_num) {
+            ResidentSet &set = residentSet(pid);
+            ResidentLink &link = links_.edit(frame_num);
+
+            link.prev_ = set.tail_;
+            link.next_ = -1;
+            link.queued_at_ = timestampOf(frame_num);
+
+            if (set.tail_ >= 0) {
+                links_.edit(set.tail_).next_ = frame_num;
+            } else {
+                set.head_ = frame_num;
+            }
+
+            set.tail_ = frame_num;
+            set.resident_++;
+        }
+
+        /**
+         * @pid: process that owns the page of @frame_num.
+         * @frame_num: frame removed from the resident set of @pid in constant time.
+         */
+        void unlinkResident(int pid, int frame_num) {
+            ResidentSet &set = residentSet(pid);
+            ResidentLink link = links_[frame_num];
+
+            if (link.prev_ >= 0) {
+                links_.edit(link.prev_).next_ = link.next_;
+            } else {
+                set.head_ = link.next_;
+            }
+
+            if (link.next_ >= 0) {
+                links_.edit(link.next_).prev_ = link.prev_;
+            } else {
+                set.tail_ = link.prev_;
+            }
+
+            set.resident_--;
+        }
+
+        /**
+         * @key: the (pid, page#) key removed from the frame index.
+         */
+        void unindexFrame(long long key) {
+            FrameStripe &stripe = stripeOf(key);
+            lock_guard<mutex> lock(stripe.mutex_);
+
+            stripe.frames_.edit().erase(key);
+        }
 };
 
+typedef BasicMemoryTable<RuntimeGeometry> MemoryTable;
+
 #endif
\ No newline at end of file
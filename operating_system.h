@@ -6,17 +6,147 @@
 #ifndef OPERATING_SYSTEM_H
 #define OPERATING_SYSTEM_H
 
-#include <iostream>
-#include <list>
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
+#include "backing_store.h"
+#include "buffer_cache.h"
+#include "cow_array.h"
 #include "disks.h"
+#include "geometry.h"
 #include "process.h"
 #include "memory_table.h"
 
 using namespace std;
 
-class OperatingSystem {
+/**
+ * What the time slice of the running process is counted in. Ticks are the
+ * commands of the simulated clock, references are the 'm' and 'w' commands
+ * of the running process.
+ */
+enum QuantumUnit {
+    QUANTUM_TICKS,
+    QUANTUM_REFERENCES
+};
+
+/**
+ * The result of an OperatingSystem command. Only OS_OK changed anything.
+ */
+enum OsStatus {
+    OS_OK,
+    OS_CPU_IDLE,
+    OS_NO_CHILDREN,
+    OS_PIDS_EXHAUSTED,
+    OS_NO_SUCH_DISK,
+    OS_DISK_IS_GROUP,
+    OS_DISK_IDLE,
+    OS_INVALID_REQUEST
+};
+
+/**
+ * The commands that can be submitted in a batch, see OsRequest.
+ */
+enum OsOperation {
+    OP_SPAWN,
+    OP_FORK,
+    OP_PREEMPT,
+    OP_EXIT,
+    OP_WAIT,
+    OP_USE_MEMORY,
+    OP_USE_DISK,
+    OP_FINISH_DISK,
+    OP_SET_PRIORITY,
+    OP_TICK
+};
+
+/**
+ * Struct for one command of a batch.
+ *
+ * @operation_: what the command does.
+ * @value_: the address for OP_USE_MEMORY, the disk for OP_USE_DISK and
+ * OP_FINISH_DISK, the priority for OP_SET_PRIORITY, the number of ticks for OP_TICK.
+ * @filename_: the file of OP_USE_DISK.
+ * @write_: true to write instead of read with OP_USE_MEMORY and OP_USE_DISK.
+ */
+struct OsRequest {
+    OsOperation operation_;
+    long value_;
+    string filename_;
+    bool write_;
+
+    OsRequest() : operation_{OP_TICK}, value_{1}, write_{false}
+        { }
+
+    OsRequest(OsOperation operation, long value) :
+        operation_{operation}, value_{value}, write_{false}
+        { }
+
+    OsRequest(OsOperation operation, long value, string filename, bool write) :
+        operation_{operation}, value_{value}, filename_{filename}, write_{write}
+        { }
+};
+
+/**
+ * Struct that holds the processes of the CPU. @running_ is 0 when the CPU is
+ * idle, @ready_ are the processes behind it in the ready queue. The time slice
+ * fields are only meaningful when @quantum_ is not 0.
+ */
+struct CpuSnapshot {
+    int running_;
+    vector<int> ready_;
+    vector<int> waiting_;
+    long quantum_;
+    QuantumUnit quantum_unit_;
+    long slice_used_;
+    long slices_expired_;
+};
+
+/**
+ * Struct that holds the state of every disk and disk group.
+ *
+ * @time_: the simulated time of the snapshot.
+ * @disks_: the physical disks, in order.
+ * @groups_: the disk groups, numbered after the physical disks.
+ * @writeback_disk_: the disk that receives write-backs, -1 if none.
+ * @backing_: one entry per disk with the measured file I/O, empty if there
+ * is no BackingStore.
+ * @cache_: the buffer cache counters of every disk and then every group,
+ * empty if the buffer cache is off.
+ */
+struct IoSnapshot {
+    long time_;
+    vector<DiskSnapshot> disks_;
+    vector<DiskGroup> groups_;
+    int writeback_disk_;
+    long writeback_requests_;
+    long writeback_completed_;
+    vector<DiskIoStats> backing_;
+    CachePolicy cache_policy_;
+    int cache_capacity_;
+    int cache_blocks_;
+    vector<CacheStats> cache_;
+};
+
+/**
+ * The OperatingSystem can be driven from several threads at once. The scheduler
+ * state (ready queue, waiting processes and the process table) is guarded
+ * by @scheduler_mutex_, which also serializes the disks, the disk groups and the
+ * buffer cache. The MemoryTable locks per stripe of its frame index. Locks are
+ * always taken in the order scheduler, memory table.
+ *
+ * No method prints anything. Commands return an OsStatus and snapshots return
+ * plain structs, the CLI (see command_interpreter.h) does all the formatting.
+ *
+ * The page size, number of frames and number of disks come from the Geometry
+ * (see geometry.h). OperatingSystem is the version configured at run time, the
+ * profiles in simulator.cc use a FixedGeometry so that they are known to the
+ * compiler.
+ */
+template <class Geometry>
+class BasicOperatingSystem {
     public: 
 
         /**
@@ -24,93 +154,201 @@ class OperatingSystem {
          * 4GB for memory_size_ and 1GB for page_size_ and 2 for the disk_count_
          * 
          */
-        OperatingSystem() : 
-            memory_size_{4000000000}, page_size_{1000000000}, 
-            disk_count_{2}, process_count_{1}
-            { 
-                for (int i = 0; i < disk_count_; i++) {
-                    disks_.push_back(new Disk());
-                }
-            } 
+        BasicOperatingSystem() : BasicOperatingSystem(4000000000, 1000000000, 2)
+            { } 
 
         /**
          * @memory_size: the amount of memory that will be available to the OS (in bytes)
          * @page_size: the size of the memory page.
          * @disk_count: the amount of disks the system has.
-         * @num_frames_: is the number of frames that the OS has. Value is calculated within the 
-         * constructor.
          * 
+         * The number of frames that the OS has is calculated by the Geometry.
          */
-        OperatingSystem(long memory_size, int page_size, int disk_count) : 
-            memory_size_{memory_size}, page_size_{page_size}, 
-            disk_count_{disk_count}, process_count_{1}
+        BasicOperatingSystem(long memory_size, int page_size, int disk_count) : 
+            geometry_{memory_size, page_size, disk_count}, memory_size_{memory_size},
+            io_request_count_{0}, clock_{0}, backing_store_{nullptr},
+            next_home_node_{0}, writeback_disk_{-1}, writeback_requests_{0},
+            writeback_completed_{0}, quantum_{0}, quantum_unit_{QUANTUM_TICKS}, slice_pid_{0},
+            slice_used_{0}, slices_expired_{0}
             {
-                num_frames_ = memory_size_ / page_size;
-                memory_table_ = new MemoryTable(num_frames_);
+                memory_table_ = new BasicMemoryTable<Geometry>(geometry_);
 
-                for (int i = 0; i < disk_count; i++) {
-                    disks_.push_back(new Disk());
-                }                
+                sizeStorage(disks_, geometry_.diskCount());
             }
 
         /**
-         * Function that is called whenever the user needs help on 
-         * how to use the OS.
+         * Destructor that frees the memory table. The disks free themselves.
+         */
+        ~BasicOperatingSystem() {
+            delete memory_table_;
+        }
+
+        /**
+         * Returns a new OperatingSystem that starts in exactly the state of this
+         * one, to try a different continuation on it. The branch shares the
+         * process table, the frames and frame index, the disk queues, the buffer
+         * cache and the disk group requests with this OS, and either of them only
+         * copies a part once it changes it (see cow_array.h). Branching takes
+         * constant time no matter how many processes, frames or disk entries
+         * there are.
+         * 
+         * Must not be called while another thread uses this OS. Afterwards the
+         * OS and its branches can be driven from different threads at the same
+         * time, and branches can be branched again. The caller deletes the
+         * branch. Returns nullptr if a BackingStore or a swap area is attached,
+         * since the files they use cannot be branched.
+         */
+        BasicOperatingSystem* branch() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (backing_store_ != nullptr || memory_table_->hasSwap()) { return nullptr; }
+
+            return new BasicOperatingSystem(*this);
+        }
+
+        /**
+         * @max_pid: the largest pid handed out, see "process.h". Must be
+         * called before the first process is created.
+         */
+        void setMaxPid(int max_pid) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            processes_.setMaxPid(max_pid);
+        }
+
+        int maxPid() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            return processes_.maxPid();
+        }
+
+        /**
+         * Returns the pid of the process using the CPU, 0 if it is idle.
+         */
+        int runningProcess() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            return ready_queue_.front();
+        }
+
+        /**
+         * @config: the NUMA configuration of the memory, see "memory_table.h".
+         * Must be called before the first process is created.
+         */
+        void configureNuma(NumaConfig config) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            memory_table_->configureNodes(config);
+        }
+
+        /**
+         * @max_pages: the most pages a page fault may prefetch, 0 to turn
+         * prefetching off. See "memory_table.h".
+         */
+        void setPrefetchLimit(int max_pages) {
+            memory_table_->setPrefetchLimit(max_pages);
+        }
+
+        /**
+         * @disk_number: physical disk that receives the write-back of dirty
+         * pages, -1 to turn write-back off.
+         * @batch_pages: most dirty pages written by one request.
+         * @dirty_ratio: percentage of dirty frames above which the flusher
+         * cleans pages before they are evicted.
+         * 
+         * Returns false if @disk_number is not a physical disk.
+         */
+        bool configureWriteBack(int disk_number, int batch_pages, int dirty_ratio) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (disk_number >= geometry_.diskCount() || batch_pages < 1) { return false; }
+
+            writeback_disk_ = disk_number < 0 ? -1 : disk_number;
+            memory_table_->configureWriteBack(writeback_disk_ < 0 ? 0 : batch_pages, dirty_ratio);
+            return true;
+        }
+
+        /**
+         * @capacity: the most blocks the buffer cache holds, 0 to turn it off.
+         * @policy: LRU or 2Q, see "buffer_cache.h".
+         * 
+         * Once a block of a disk is cached, reading it again with 'd' sends the
+         * process straight back to the @ready_queue_ instead of queuing on the
+         * disk.
+         */
+        void configureBufferCache(int capacity, CachePolicy policy) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            buffer_cache_.edit().configure(capacity, policy);
+        }
+
+        /**
+         * @config: how the frames are divided between the processes and
+         * whether a process replaces its own pages, see "memory_table.h".
+         * Must be called before the first process is created.
+         */
+        void configureQuotas(QuotaConfig config) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            memory_table_->configureQuotas(config);
+        }
+
+        /**
+         * @quantum: length of a time slice, 0 to only preempt with 'Q'.
+         * @unit: whether the slice is counted in ticks or memory references.
+         * 
+         * Once the running process used up its slice it is preempted
+         * automatically, exactly like with the 'Q' command.
          */
+        void setQuantum(long quantum, QuantumUnit unit) {
+            lock_guard<mutex> lock(scheduler_mutex_);
 
-        void help() {
-            cout << "\n=================================HELP================================" << endl;
-            cout << "'A' to generate process" << endl;
-            cout << "'Q' to preempt current running process" << endl;
-            cout << "'fork' to generate child process for current running proc" << endl;
-            cout << "'exit' to end execution of current running process" << endl;
-            cout << "'wait' to pause execution for current running process" << endl;
-            cout << "'d <disk_num> <filename>' to have current proc use disk<disk_num>" << endl;
-            cout << "'D <disk_num>' to finish work on disk <disk_num>" << endl;
-            cout << "'m <address>' to have current process use memory at <address>" << endl;
-            cout << "'S r' to display a snapshot of the ready queue" << endl;
-            cout << "'S i' to display a snapshot of the disks" << endl;
-            cout << "'S m' to display a snapshow of the memory table" << endl;
-            cout << "'help' to display this message agains" << endl;
-            cout << "'bsod' to end the simulation" << endl;
-            cout << "=====================================================================\n" << endl;
+            quantum_ = quantum < 0 ? 0 : quantum;
+            quantum_unit_ = unit;
+            slice_used_ = 0;
         }
 
         /**
-         * Increments the @process_coint_ and then pushes back 
-         * a new process to the ready queue. 
+         * Allocates a pid and then pushes back 
+         * a new process to the ready queue. The new process gets the next
+         * NUMA node as its home, round robin.
          * 
          * Function used for the 'A' command.
          */
-        void spawnProcess() {
-            process_count_++;
-            ready_queue_.push_back(new Process(process_count_, 1));
+        OsStatus spawnProcess() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            int pid = processes_.allocate(1);
+            if (pid == 0) { return OS_PIDS_EXHAUSTED; }
+
+            processes_.setHomeNode(pid, next_home_node_);
+            next_home_node_ = (next_home_node_ + 1) % memory_table_->nodeCount();
+            memory_table_->setPriority(pid, processes_.priority(pid));
+            processes_.pushBack(ready_queue_, pid, PROCESS_READY);
+            return OS_OK;
         }
 
         /**
          * The current running process (front of @ready_queue_) has a new process 
          * a new process generated.
          * 
-         * A pointer to the running process (@parent_proc) is created. Then @process_count_
-         * is incremented and @parent_proc generates a child process see more in "process.h"
-         * Then add a new process to the back of the @ready_queue_. 
+         * A pid is allocated and the new process is added to the running
+         * process's children (see more in "process.h"), runs on the same
+         * NUMA node and has the same priority. Then add the new process to
+         * the back of the @ready_queue_.
          * 
          * Function used for the 'fork' command.
          */
-        void forkProcess() {
-            if (ready_queue_.empty()) {
-                cout << "COMMAND FAILED: CPU IS IDLE" << endl;
-                cout << "Enter Different Command\n" << endl;
-                return;
-            }
+        OsStatus forkProcess() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (ready_queue_.empty()) { return OS_CPU_IDLE; }
 
-            Process* parent_proc = ready_queue_.front();
+            int parent_pid = ready_queue_.front();
             
-            process_count_++;
-            parent_proc->spawnChildProc(process_count_);
-            ready_queue_.push_back(new Process(process_count_, parent_proc->getPID()));
+            int child_pid = processes_.allocate(parent_pid);
+            if (child_pid == 0) { return OS_PIDS_EXHAUSTED; }
 
-            parent_proc = nullptr;  
+            processes_.addChild(parent_pid, child_pid);
+            processes_.setHomeNode(child_pid, processes_.homeNode(parent_pid));
+            processes_.setPriority(child_pid, processes_.priority(parent_pid));
+            memory_table_->setPriority(child_pid, processes_.priority(parent_pid));
+            processes_.pushBack(ready_queue_, child_pid, PROCESS_READY);
+            return OS_OK;
         }
 
         /**
@@ -119,37 +357,58 @@ class OperatingSystem {
          * 
          * Function used for the 'Q' command.
          */
-        void preemptProcess() {
-            Process* running_process = ready_queue_.front();
+        OsStatus preemptProcess() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (ready_queue_.empty()) { return OS_CPU_IDLE; }
+
+            int running_pid = processes_.popFront(ready_queue_);
+            processes_.pushBack(ready_queue_, running_pid, PROCESS_READY);
+            slice_used_ = 0;
+            return OS_OK;
+        }
+
+        /**
+         * @priority: the new priority of the running process, at least 1.
+         * 
+         * With priority quotas the running process gets a share of the frames
+         * proportional to @priority. Children forked afterwards inherit it.
+         * 
+         * Function used for the 'P <priority>' command.
+         */
+        OsStatus setPriority(int priority) {
+            lock_guard<mutex> lock(scheduler_mutex_);
 
-            ready_queue_.pop_front();
-            ready_queue_.push_back(running_process);
+            if (ready_queue_.empty()) { return OS_CPU_IDLE; }
+            if (priority < 1) { return OS_INVALID_REQUEST; }
 
-            running_process = nullptr;
+            int running_pid = ready_queue_.front();
+            processes_.setPriority(running_pid, priority);
+            memory_table_->setPriority(running_pid, priority);
+            return OS_OK;
         }
 
         /**
-         * Function will tell the user that the CPU is idle if there is
-         * no new processes using or waiting for the CPU. If there are then 
-         * the recursive private fucntion terminateProcess(...) is called. 
+         * Returns OS_CPU_IDLE if there is no new processes using or
+         * waiting for the CPU. If there are then the private fucntion
+         * terminateProcess(...) is called. 
          * 
          * Function used for the 'exit' command.
          */
-        void exitProcess() {
-            if (ready_queue_.empty()) {
-                cout << "COMMAND FAILED: CPU IS IDLE" << endl;
-                cout << "Enter Different Command\n" << endl;
-                return; 
-            }
+        OsStatus exitProcess() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (ready_queue_.empty()) { return OS_CPU_IDLE; }
 
             terminateProcess(ready_queue_.front());
+            return OS_OK;
         }
 
 
         /**
-         * This function will tell the user that the command failed 
-         * if there is no processes using or waiting for the CPU OR 
-         * if the process has no child to wait for.
+         * This function returns OS_CPU_IDLE if there is no processes using
+         * or waiting for the CPU OR OS_NO_CHILDREN if the process has no
+         * child to wait for.
          * 
          * If a process has zombie children do not send it to the
          * @waiting_for_child_ vector but instead it remains using the CPU 
@@ -158,342 +417,803 @@ class OperatingSystem {
          * Function used for 'wait' command.
          */
 
-        void waitProcess() {
-            if (ready_queue_.empty()) {
-                cout << "COMMAND FAILED: CPU IS IDLE" << endl;
-                cout << "Enter Different Command\n" << endl;
-                return; 
-            }
+        OsStatus waitProcess() {
+            lock_guard<mutex> lock(scheduler_mutex_);
 
-            if (!ready_queue_.front()->hasChildren() && !ready_queue_.front()->hasZombies()) {
-                cout << "COMMAND FAILED: " << ready_queue_.front() << " HAS NO CHILDREN" << endl;
-                cout << "Enter Different Command\n" << endl;
-                return; 
+            if (ready_queue_.empty()) { return OS_CPU_IDLE; }
+
+            int running_pid = ready_queue_.front();
+
+            if (!processes_.hasChildren(running_pid) && !processes_.hasZombies(running_pid)) {
+                return OS_NO_CHILDREN;
             }
 
-            if (ready_queue_.front()->hasZombies()) {
-                ready_queue_.front()->useZombie();
+            if (processes_.hasZombies(running_pid)) {
+                processes_.useZombie(running_pid);
             } else {
-                Process* temp = ready_queue_.front();
-                ready_queue_.pop_front();
-                waiting_for_child_.push_back(temp);
+                processes_.popFront(ready_queue_);
+                processes_.pushBack(waiting_for_child_, running_pid, PROCESS_WAITING);
             }
+            return OS_OK;
         }
 
         /**
          * @logical_address: the "logical_address" that the current running process wants to use.
          * 
          * Function creates an entry into the @memory_table_ using the page number calculated from
-         * @logical_address / @page_size_. 
+         * @logical_address / page size, which the Geometry turns into a shift when the
+         * page size is a power of two known at compile time. 
+         * 
+         * The scheduler lock is only held long enough to read the running
+         * process so references from different threads reach the memory table
+         * in parallel.
          * 
          * Function used for 'm <address>' command.
          */
-        void useMemory(int logical_address) {
-            if (ready_queue_.empty()) {
-                cout << "COMMAND FAILED: CPU IS IDLE" << endl;
-                cout << "Enter Different Command\n" << endl;
-                return;
+        OsStatus useMemory(int logical_address) {
+            return useMemory(logical_address, false);
+        }
+
+        /**
+         * @logical_address: the "logical_address" that the current running process wants to use.
+         * @write: true if the process writes the memory, which makes the page dirty.
+         * 
+         * Same as useMemory(...) above. If any process is terminated between
+         * reading the running process and changing the memory table, the pid
+         * may already belong to someone else, so the memory table refuses the
+         * reference and it is made again under the scheduler lock, unless the
+         * process was the one terminated. A negative @logical_address is
+         * refused with OS_INVALID_REQUEST.
+         * 
+         * Function used for 'w <address>' command.
+         */
+        OsStatus useMemory(int logical_address, bool write) {
+            if (logical_address < 0) { return OS_INVALID_REQUEST; }
+
+            int pid;
+            int home_node;
+            unsigned generation;
+            long epoch;
+
+            {
+                lock_guard<mutex> lock(scheduler_mutex_);
+
+                if (ready_queue_.empty()) { return OS_CPU_IDLE; }
+
+                pid = ready_queue_.front();
+                home_node = processes_.homeNode(pid);
+                generation = processes_.generation(pid);
+                epoch = memory_table_->releaseEpoch();
+                if (memory_table_->quotasEnabled()) { processes_.countReference(pid); }
+
+                if (quantum_ > 0 && quantum_unit_ == QUANTUM_REFERENCES) {
+                    chargeSlice(1);
+                }
             }
 
-            int page_num = logical_address / page_size_;
-            memory_table_->insertFrame(page_num, ready_queue_.front()->getPID());
+            int page_num = geometry_.pageNumber(logical_address);
+            if (memory_table_->insertFrame(page_num, pid, home_node, write, epoch)) { return OS_OK; }
+
+            /* A process was terminated meanwhile: retry where none can be, if ours is still alive. */
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (processes_.state(pid) != PROCESS_FREE && processes_.generation(pid) == generation) {
+                memory_table_->insertFrame(page_num, pid, home_node, write, memory_table_->releaseEpoch());
+            }
+            return OS_OK;
         }
 
         /**
          * @disk_number: The disk that will be used accessed. 
          * @filename: name of the file that process will use on the disk.
          * 
-         * If the user enters an invalid number (greater than @disk_count_ or negative) 
-         * report to the user and return to the caller. Otherwise create a new into that
+         * If the user enters an invalid number (greater than the disk count or negative) 
+         * OS_NO_SUCH_DISK is returned. Otherwise create a new into that
          * disk's queue. 
          * 
          * Function used for the command 'd <disk_number> <filename>'
          */
-        void useDisk(int disk_number, string filename) {
-            if (ready_queue_.empty()) {
-                cout << "COMMAND FAILED: CPU IS IDLE" << endl;
-                cout << "Enter Different Command\n" << endl;
-                return;
+        OsStatus useDisk(int disk_number, string filename) {
+            return useDisk(disk_number, filename, false);
+        }
+
+        /**
+         * @disk_number: The disk that will be used accessed. 
+         * @filename: name of the file that process will use on the disk.
+         * @write: true if the process writes the file instead of reading it.
+         * 
+         * Same as useDisk(...) above. When a BackingStore is attached and the
+         * request is the first one in the disk's queue the real I/O is started
+         * right away. 
+         * 
+         * Disk numbers after the physical disks are the disk groups. A request
+         * to a group puts a part in the queue of every member it uses and the
+         * process only goes back to the @ready_queue_ once all of them finished.
+         * 
+         * With the buffer cache on, a read of a cached block does not queue at
+         * all: the process goes to the back of the @ready_queue_ as if the disk
+         * had finished at once. Writes always queue and leave the block cached.
+         * 
+         * Function used for the command 'd <disk_number> <filename> w'
+         */
+        OsStatus useDisk(int disk_number, string filename, bool write) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (ready_queue_.empty()) { return OS_CPU_IDLE; }
+
+            int disk_count = geometry_.diskCount();
+
+            if (disk_number < 0 || disk_number >= disk_count + (int) groups_.size()) {
+                return OS_NO_SUCH_DISK;
+            }
+
+            if (buffer_cache_->enabled()) {
+                if (write) {
+                    buffer_cache_.edit().write(disk_number, filename);
+                } else if (buffer_cache_.edit().read(disk_number, filename)) {
+                    int pid = processes_.popFront(ready_queue_);
+                    processes_.pushBack(ready_queue_, pid, PROCESS_READY);
+                    return OS_OK;
+                }
             }
 
-            if (disk_number < 0 || disk_number >= disk_count_) {
-                cout << "ERROR: Disk " << disk_number << " does not exist" << endl;
-                cout << endl;
+            if (disk_number >= disk_count) {
+                useGroup(disk_number - disk_count, filename, write);
             } else {
-                disks_[disk_number]->addEntry(ready_queue_.front(), filename);
-                ready_queue_.pop_front();
+                int pid = processes_.popFront(ready_queue_);
+                processes_.setState(pid, PROCESS_BLOCKED);
+                queuePart(disk_number, pid, filename, write);
             }
+            return OS_OK;
+        }
+
+        /**
+         * @level: RAID_0 to stripe, RAID_1 to mirror.
+         * @members: the physical disks of the group, each used once.
+         * 
+         * Returns the disk number of the new group, or -1 if a member does
+         * not exist or is given twice.
+         */
+        int addDiskGroup(RaidLevel level, vector<int> members) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            vector<bool> used(geometry_.diskCount(), false);
+            if (members.empty()) { return -1; }
+
+            for (auto &member : members) {
+                if (member < 0 || member >= geometry_.diskCount() || used[member]) {
+                    return -1;
+                }
+                used[member] = true;
+            }
+
+            groups_.push_back(DiskGroup(level, members));
+            return geometry_.diskCount() + groups_.size() - 1;
         }
 
         /**
          * @disk_number: the number of the disk that has finished it works.
          * 
          * This function calls finishUsage() function of the Disk class. Which returns
-         * the pointer to the process that was using the disk and send it to the 
-         * end of the @ready_queue. (see disks.h for more info.) 
+         * the pid of the process that was using the disk and send it to the 
+         * end of the @ready_queue. (see disks.h for more info.) Returns
+         * OS_DISK_IS_GROUP, OS_NO_SUCH_DISK or OS_DISK_IDLE if there is
+         * nothing to finish.
          * 
          * Function used for 'D <disknumber>' command
          */
-        void finishDiskUsage(int disk_number) {
-            if (disk_number < 0 || disk_number >= disk_count_) {
-                cout << "ERROR: Disk " << disk_number << " does not exist" << endl;
-                cout << endl;
-            } else {
-                ready_queue_.push_back(disks_[disk_number]->finishUsage());
+        OsStatus finishDiskUsage(int disk_number) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            if (disk_number >= geometry_.diskCount() &&
+                disk_number < geometry_.diskCount() + (int) groups_.size()) {
+                return OS_DISK_IS_GROUP;
+            } else if (disk_number < 0 || disk_number >= geometry_.diskCount()) {
+                return OS_NO_SUCH_DISK;
+            } else if (!completeDiskUsage(disk_number)) {
+                return OS_DISK_IDLE;
             }
+            return OS_OK;
         }
 
         /**
-         * Will display the currently running process along with all 
-         * processes waiting in the @ready_queue_. If there are no 
-         * processes running (@ready_queue is empty) it reports that the 
-         * CPU is idle. Otherwise there the process using the CPU and the 
-         * processes in the @ready_queue_ are also displayed.
+         * @backing_store: the store that performs the real file I/O.
          * 
-         * Function used for 'S r' command.
+         * Every disk request made after this call reads or writes a real
+         * file. See "backing_store.h" for more info.
          */
-        void snapshotCPU() {
-            if (ready_queue_.empty()) {
-                cout << "CPU: IDLE" << endl;
-            } else {
-                cout << "CPU: " << *(ready_queue_.front()) << endl;
+        void attachBackingStore(BackingStore* backing_store) {
+            backing_store_ = backing_store;
+        }
 
-                if (ready_queue_.size() == 1) {
-                    cout << "Ready Queue: EMPTY" << endl;
-                }
+        /**
+         * Reaps every finished backing-file request. If the request still
+         * belongs to the entry using the disk the disk finishes its work
+         * automatically, exactly like the 'D <disk_num>' command. Completions
+         * of entries that were removed in the meantime are ignored.
+         */
+        void pollDiskCompletions() {
+            if (backing_store_ == nullptr) { return; }
 
-                if (ready_queue_.size() > 1) {
-                    cout << "Ready-Queue: " << endl;
-                    
-                   for (auto &process : ready_queue_) {
-                       if (process == ready_queue_.front()) { continue; }
-                        cout << "\t    " << *process << endl;
-                    }
+            lock_guard<mutex> lock(scheduler_mutex_);
+
+            IoCompletion completion;
+            while (backing_store_->pollCompletion(completion)) {
+                if (disks_[completion.disk_]->frontRequestId() == completion.request_id_) {
+                    completeDiskUsage(completion.disk_);
                 }
-            } 
+            }
+        }
 
-            if (waiting_for_child_.size() > 0) {
-                cout << "Waiting-for-child:" << endl;
-                for (auto &process : waiting_for_child_) {
-                    cout << "\t    " << *process << endl;
+        /**
+         * Returns the currently running process along with all 
+         * processes waiting in the @ready_queue_ and the processes waiting
+         * for a child. If there are no processes running (@ready_queue is
+         * empty) @running_ is 0.
+         * 
+         * Function used for 'S r' command.
+         */
+        CpuSnapshot snapshotCPU() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            CpuSnapshot snapshot;
+
+            snapshot.running_ = ready_queue_.front();
+            if (snapshot.running_ != 0) {
+                snapshot.ready_.reserve(ready_queue_.size_ - 1);
+                for (int pid = processes_.next(snapshot.running_); pid != 0; pid = processes_.next(pid)) {
+                    snapshot.ready_.push_back(pid);
                 }
             }
 
-            cout << endl;
+            snapshot.waiting_.reserve(waiting_for_child_.size_);
+            for (int pid = waiting_for_child_.front(); pid != 0; pid = processes_.next(pid)) {
+                snapshot.waiting_.push_back(pid);
+            }
+
+            snapshot.quantum_ = quantum_;
+            snapshot.quantum_unit_ = quantum_unit_;
+            snapshot.slice_used_ = snapshot.running_ != 0 && snapshot.running_ == slice_pid_ ? slice_used_ : 0;
+            snapshot.slices_expired_ = slices_expired_;
+
+            return snapshot;
         }
 
         /**
+         * @delta: when true only the frames that changed since the previous
+         * memory snapshot are returned.
+         * 
          * A publicly exposed version of @class: MemoryTable 
          * snapshotMemory() (see MemoryTable for more info). 
          * 
-         * Function used for 'S m' command.
+         * Function used for 'S m' and 'S m +' commands.
          */
-        void snapshotMemory() {
-            memory_table_->snapshotMemory();
+        vector<FrameRow> snapshotMemory(bool delta) {
+            return memory_table_->snapshotMemory(delta);
         }
 
         /**
-         * A publicly facing method that will show the staus of all the disks of the
-         * OS.
+         * A publicly exposed version of @class: MemoryTable 
+         * snapshotSwap() (see MemoryTable for more info). 
          * 
-         * Function used for 'S i' command.
+         * Function used for 'S s' command.
          */
-        void snapshotIO() {
-            for (int i = 0; i < disk_count_; i++) {
-                cout << "Disk " << i << ": ";
-                disks_[i]->showEntries();
-            }
+        SwapSnapshot snapshotSwap() {
+            return memory_table_->snapshotSwap();
         }
-  
-    private: 
+
         /**
-         * @memory_size_: the amount of available memory the system has
-         * @page_size_: the size of each memory page.
-         * @disk_count_: Number of disks available to the systems.
-         * @process_count_: the count that will be used to make new PIDs,
-         * also ensures that each ID is unique.
-         * @ready_queue_: the Operating System's ready queue.
-         * @waiting_for_child_: vector that holds all processes that 
-         * are waiting on their children to finish execution.
-         * @disk_: a vector of all the disks that the operating system has.
-         * @num_frames: The number of frames the OS has.
+         * A publicly exposed version of @class: MemoryTable 
+         * snapshotNodes() (see MemoryTable for more info). 
+         * 
+         * Function used for 'S n' command.
          */
-        long memory_size_;
-        int page_size_;
-        int disk_count_;
-        int process_count_;
-        list<Process*> ready_queue_;
-        vector<Process*> waiting_for_child_;
-        vector<Disk*> disks_;
-        MemoryTable* memory_table_;
-        int num_frames_;
+        NodeSnapshot snapshotNodes() {
+            return memory_table_->snapshotNodes();
+        }
 
         /**
-         * @pid: the pid of the process to be found within the @ready_queue. 
-         * 
-         * Iterate through the @ready_queue and if a Process has the same pid
-         * as the one passed as a parameter fucntion returns the pointer to that Process.
+         * A publicly exposed version of @class: MemoryTable 
+         * snapshotQuotas() (see MemoryTable for more info), with the
+         * references of every process filled in.
          * 
-         * If the Process is not in the @ready_queue_ then search the @disks_ and if the process
-         * is not there then search the @waiting_for_children_ vector.
+         * Function used for 'S q' command.
          */
-        Process* findProcess(int pid) {
-            for (auto &process : ready_queue_) {
-                if (process->getPID() == pid) {
-                    return process;
-                }
+        QuotaSnapshot snapshotQuotas() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            QuotaSnapshot snapshot = memory_table_->snapshotQuotas();
+
+            for (auto &process : snapshot.processes_) {
+                process.references_ = processes_.references(process.pid_);
             }
 
-            for (auto &disk : disks_) {
-                if (disk->seachDisks(pid) != nullptr) {
-                    return disk->seachDisks(pid);
+            return snapshot;
+        }
+
+        /**
+         * @swap: the swap area that will receive evicted pages.
+         * 
+         * See "swap_area.h" for more info.
+         */
+        void attachSwap(SwapArea* swap) {
+            memory_table_->attachSwap(swap);
+        }
+
+        /**
+         * Returns the status of all the disks and disk groups of the OS,
+         * with the measured file I/O if a BackingStore is attached.
+         * 
+         * Function used for 'S i' and 'S i json' commands.
+         */
+        IoSnapshot snapshotIO() {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            IoSnapshot snapshot;
+
+            snapshot.time_ = clock_;
+            for (int i = 0; i < geometry_.diskCount(); i++) {
+                snapshot.disks_.push_back(disks_[i]->snapshot(clock_));
+
+                if (backing_store_ != nullptr) {
+                    snapshot.backing_.push_back(backing_store_->getStats(i));
                 }
             }
 
-            for (auto &process : waiting_for_child_) {
-                if (process->getPID() == pid) {
-                    return process;
-                }
-            }            
+            snapshot.groups_ = groups_;
+            snapshot.writeback_disk_ = writeback_disk_;
+            snapshot.writeback_requests_ = writeback_requests_;
+            snapshot.writeback_completed_ = writeback_completed_;
+
+            snapshot.cache_policy_ = buffer_cache_->policy();
+            snapshot.cache_capacity_ = buffer_cache_->capacity();
+            snapshot.cache_blocks_ = buffer_cache_->size();
+            if (buffer_cache_->enabled()) {
+                snapshot.cache_ = buffer_cache_->snapshot(geometry_.diskCount() + groups_.size());
+            }
 
-            return nullptr;
+            return snapshot;
         }
 
         /**
-         * @pid: The process whose iterator that need to be found.
+         * @request: one command.
          * 
-         * Similar to function findProcess(...) but instead the function
-         * will return the iterator to the function. This is used to help 
-         * remove items from the @ready_queue_ since stl_list items can 
-         * only be erased via iterators.
+         * Advances the clock by one tick, like every command of the CLI, and
+         * runs @request. OP_TICK advances the clock by @request.value_ ticks
+         * in all.
          */
-        list<Process*>::iterator findProcessItr(int pid) {
-            for (list<Process*>::iterator itr = ready_queue_.begin(); 
-                 itr != ready_queue_.end(); ++itr) {
-                     if ((*itr)->getPID() == pid) {
-                         return itr;
-                     }
-               }    
+        OsStatus submit(const OsRequest& request) {
+            if (request.operation_ == OP_TICK) {
+                if (request.value_ < 1) { return OS_INVALID_REQUEST; }
+
+                advanceClock(request.value_);
+                return OS_OK;
+            }
 
-            return ready_queue_.end();
+            advanceClock();
+
+            switch (request.operation_) {
+                case OP_SPAWN:
+                    return spawnProcess();
+                case OP_FORK:
+                    return forkProcess();
+                case OP_PREEMPT:
+                    return preemptProcess();
+                case OP_EXIT:
+                    return exitProcess();
+                case OP_WAIT:
+                    return waitProcess();
+                case OP_USE_MEMORY:
+                    return useMemory((int) request.value_, request.write_);
+                case OP_USE_DISK:
+                    return useDisk((int) request.value_, request.filename_, request.write_);
+                case OP_FINISH_DISK:
+                    return finishDiskUsage((int) request.value_);
+                case OP_SET_PRIORITY:
+                    return setPriority((int) request.value_);
+                default:
+                    return OS_INVALID_REQUEST;
+            }
         }
 
         /**
-         * @terminated: A pointer to the process whose execution will end.
+         * @batch: commands run in order.
+         * @results: receives the status of every command of @batch.
          * 
-         * First check to see if @terminated has children. If there are children
-         * we signal to the children that the parent is dead and then terminate
-         * the children processes. (cascading termination)
+         * Finished backing-file I/O is reaped once before the batch, like the
+         * CLI does before every line.
+         */
+        void submit(const vector<OsRequest>& batch, vector<OsStatus>& results) {
+            pollDiskCompletions();
+
+            results.clear();
+            results.reserve(batch.size());
+            for (auto &request : batch) {
+                results.push_back(submit(request));
+            }
+        }
+
+        /**
+         * Advances the simulated clock by one tick. Called once for every
+         * command, so disk latencies are measured in commands. The flusher of
+         * dirty pages runs on every tick, see writeBack().
+         */
+        void advanceClock() {
+            advanceClock(1);
+        }
+
+        /**
+         * @ticks: number of ticks the clock moves forward.
          * 
-         * Then release all the resources that @terminated may have been using. 
-         * Memory or disk usage. 
+         * Same as calling advanceClock() @ticks times, but in constant time
+         * (plus one pass over the ready queue at most) no matter how many
+         * time slices expire in between. The flusher runs once.
          * 
-         * Then a check to see if @terminated's parent is not dead (if you terminate
-         * a child process but the parent is still alive.) If the parent is still alive
-         * check to see if it is waiting on its child to end termination. If true "wakeup"
-         * the parent (send it back to the @ready_queue_) otherwise the parent loses a child and
-         * gains a zombie. 
+         * Function used for 't <n>' command.
+         */
+        void advanceClock(long ticks) {
+            lock_guard<mutex> lock(scheduler_mutex_);
+            if (ticks < 1) { return; }
+
+            long before = clock_;
+            clock_ += ticks;
+
+            if (quantum_ > 0 && quantum_unit_ == QUANTUM_TICKS) {
+                chargeSlice(ticks);
+            }
+
+            if (writeback_disk_ >= 0) {
+                writeBack(before / kWriteBackInterval != clock_ / kWriteBackInterval);
+            }
+        }
+
+    private: 
+        static const int kWriteBackInterval = 32;
+
+        /**
+         * @geometry_: page size, number of frames and number of disks.
+         * @memory_size_: the amount of available memory the system has
+         * @processes_: the fields of every process, indexed by pid. Also
+         * hands out the pids.
+         * @ready_queue_: the Operating System's ready queue.
+         * @waiting_for_child_: queue that holds all processes that 
+         * are waiting on their children to finish execution.
+         * @disks_: all the disks that the operating system has, each shared
+         * with the branches until one of them changes it.
+         * @io_request_count_: the count used to give every disk request a unique id.
+         * @backing_store_: performs the real file I/O, nullptr if disabled.
+         * @clock_: the simulated time, advanced by one tick per command.
+         * @next_home_node_: NUMA node given to the next process made with 'A'.
+         * @groups_: the disk groups, numbered after the physical disks.
+         * @group_requests_: the unfinished disk group request of every process
+         * that has one.
+         * @writeback_disk_: the disk dirty pages are written to, -1 if write-back is off.
+         * @writeback_requests_: write-back requests queued on @writeback_disk_.
+         * @writeback_completed_: write-back requests that finished.
+         * @quantum_: length of a time slice, 0 if processes are only preempted by 'Q'.
+         * @quantum_unit_: what @quantum_ counts.
+         * @slice_pid_: the process whose slice @slice_used_ is.
+         * @slice_used_: the part of the running process's slice that is used.
+         * @slices_expired_: time slices that ran out, each one a preemption.
+         * @buffer_cache_: the blocks recently used on every disk, see "buffer_cache.h".
+         * @scheduler_mutex_: guards the ready queue, the waiting processes,
+         * the process table, the disk groups and the buffer cache.
+         */
+        Geometry geometry_;
+        long memory_size_;
+        long io_request_count_;
+        long clock_;
+        BackingStore* backing_store_;
+        int next_home_node_;
+        mutex scheduler_mutex_;
+        ProcessTable processes_;
+        ProcessQueue ready_queue_;
+        ProcessQueue waiting_for_child_;
+        typename Geometry::template Storage<CowValue<Disk> >::Disks disks_;
+        vector<DiskGroup> groups_;
+        CowValue<unordered_map<int, GroupRequest> > group_requests_;
+        BasicMemoryTable<Geometry>* memory_table_;
+        int writeback_disk_;
+        long writeback_requests_;
+        long writeback_completed_;
+        long quantum_;
+        QuantumUnit quantum_unit_;
+        int slice_pid_;
+        long slice_used_;
+        long slices_expired_;
+        CowValue<BufferCache> buffer_cache_;
+
+        /**
+         * @parent: the OS that is branched, see branch(). Caller must hold the
+         * @scheduler_mutex_ of @parent.
+         */
+        BasicOperatingSystem(const BasicOperatingSystem& parent) :
+            geometry_{parent.geometry_}, memory_size_{parent.memory_size_},
+            io_request_count_{parent.io_request_count_}, clock_{parent.clock_},
+            backing_store_{nullptr}, next_home_node_{parent.next_home_node_},
+            processes_{parent.processes_}, ready_queue_{parent.ready_queue_},
+            waiting_for_child_{parent.waiting_for_child_}, disks_(parent.disks_),
+            groups_{parent.groups_}, group_requests_{parent.group_requests_},
+            writeback_disk_{parent.writeback_disk_}, writeback_requests_{parent.writeback_requests_},
+            writeback_completed_{parent.writeback_completed_}, quantum_{parent.quantum_},
+            quantum_unit_{parent.quantum_unit_}, slice_pid_{parent.slice_pid_},
+            slice_used_{parent.slice_used_}, slices_expired_{parent.slices_expired_},
+            buffer_cache_{parent.buffer_cache_}
+            {
+                memory_table_ = new BasicMemoryTable<Geometry>(*parent.memory_table_);
+            }
+
+        /**
+         * @disk_number: disk whose first entry may need to start its I/O.
          * 
-         * Finally if the @terminated is in the @ready_queue_ remove it from the @ready_queue.
+         * If a BackingStore is attached and the disk is not idle, the entry
+         * now using the disk has its file I/O submitted.
+         */
+        void startBackingIo(int disk_number) {
+            DiskEntry entry;
+            if (backing_store_ == nullptr || !disks_[disk_number]->frontEntry(entry)) { return; }
+
+            backing_store_->submit(entry.request_id_, disk_number, entry.filename_, entry.write_);
+        }
+
+        /**
+         * @disk_number: physical disk the entry is queued on.
+         * @pid: the blocked process making the request.
+         * @filename: the file used.
+         * @write: true if the file is written.
          * 
+         * Queues one entry under a new request id and starts its I/O if it is
+         * the first one in the queue. Every part of a group request gets its
+         * own id, so the BackingStore keeps the I/O of each part apart.
          */
+        void queuePart(int disk_number, int pid, string filename, bool write) {
+            io_request_count_++;
+            disks_[disk_number].edit().addEntry(pid, filename, io_request_count_, write, clock_);
 
-        void terminateProcess(Process* terminated) {
-            if (terminated->hasChildren()) {
-                for (int pid : terminated->getChildren()) {
-                    findProcess(pid)->signalParentDeath();
-                    terminateProcess(findProcess(pid));
-                }
+            if (disks_[disk_number]->frontRequestId() == io_request_count_) {
+                startBackingIo(disk_number);
+            }
+        }
+
+        /**
+         * @amount: ticks or references the running process used.
+         * 
+         * Adds @amount to the slice of the running process, a new process at the
+         * front of the @ready_queue_ starts with an unused slice. Every slice that
+         * ran out preempts the running process. Since a preemption moves the
+         * front process to the back, k preemptions in a row only rotate the
+         * queue k modulo its size times. The process left in front keeps what
+         * remains of @amount as its used slice. Caller must hold @scheduler_mutex_.
+         */
+        void chargeSlice(long amount) {
+            if (ready_queue_.empty()) {
+                slice_pid_ = 0;
+                return;
             }
 
-            memory_table_->releaseResources(terminated->getPID());
-            for (auto &disk : disks_) {
-                disk->releaseResources(terminated->getPID());
+            if (ready_queue_.front() != slice_pid_) {
+                slice_pid_ = ready_queue_.front();
+                slice_used_ = 0;
             }
 
-            if (!terminated->parentDead()) {
-                if (waitingForChild(terminated->getParentPID())) {
-                    wakeupParent(terminated->getParentPID(), terminated->getPID());
-                } else {
-                    findProcess(terminated->getParentPID())->addZombie();
-                    findProcess(terminated->getParentPID())->removeChild(terminated->getPID());
-                }
+            slice_used_ += amount;
+            if (slice_used_ < quantum_) { return; }
+
+            long expired = slice_used_ / quantum_;
+            slice_used_ %= quantum_;
+            slices_expired_ += expired;
+
+            for (long turns = expired % ready_queue_.size_; turns > 0; turns--) {
+                int running_pid = processes_.popFront(ready_queue_);
+                processes_.pushBack(ready_queue_, running_pid, PROCESS_READY);
             }
+            slice_pid_ = ready_queue_.front();
+        }
 
-            if (inReadyQueue(terminated->getPID())) {
-                ready_queue_.erase(findProcessItr(terminated->getPID()));
+        /**
+         * @close_partial: true to also write the batch of dirty pages that is
+         * not full yet.
+         * 
+         * Runs the flusher of the memory table and queues every batch of dirty
+         * pages it hands back as one write on @writeback_disk_. The OS closes a
+         * batch that is not full every kWriteBackInterval ticks. Caller must hold
+         * @scheduler_mutex_.
+         */
+        void writeBack(bool close_partial) {
+            vector<WriteBack> batches;
+            memory_table_->flushDirty(close_partial, batches);
+
+            for (auto &batch : batches) {
+                io_request_count_++;
+                writeback_requests_++;
+                disks_[writeback_disk_].edit().addWriteBack(batch.pages_, io_request_count_, clock_);
+
+                if (disks_[writeback_disk_]->frontRequestId() == io_request_count_) {
+                    startBackingIo(writeback_disk_);
+                }
             }
         }
 
-        /** 
-         * @parent_pid: pid of process we are looking for.
+        /**
+         * @group_num: index of the group in @groups_.
+         * @filename: the file used.
+         * @write: true if the file is written.
          * 
-         * Searches the @waiting_for_child_ vector for a process with a matching PID.
+         * A striped group puts a part of the request on every member. A mirrored
+         * group writes to every member and reads from the member with the
+         * shortest queue. Caller must hold @scheduler_mutex_.
          */
-        bool waitingForChild(int parent_pid) {
-            for (auto &parent : waiting_for_child_) {
-                if (parent->getPID() == parent_pid) {
-                    return true;
+        void useGroup(int group_num, string filename, bool write) {
+            DiskGroup &group = groups_[group_num];
+            vector<int> targets;
+
+            if (group.level_ == RAID_1 && !write) {
+                int least_loaded = group.members_[0];
+
+                for (auto &member : group.members_) {
+                    if (disks_[member]->queueDepth() < disks_[least_loaded]->queueDepth()) {
+                        least_loaded = member;
+                    }
                 }
+                targets.push_back(least_loaded);
+            } else {
+                targets = group.members_;
             }
 
-            return false;
+            int pid = processes_.popFront(ready_queue_);
+            processes_.setState(pid, PROCESS_BLOCKED);
+
+            for (auto &target : targets) {
+                queuePart(target, pid, filename, write);
+            }
+
+            GroupRequest request = {group_num, (int) targets.size(), clock_};
+            group_requests_.edit()[pid] = request;
+            group.requests_++;
+            group.parts_ += targets.size();
         }
 
         /**
-         * @parent_pid: the pid of the parent that needs to wake up.
-         * @child_pid: the pid of the child who is waking up the parent.
+         * @disk_number: the disk that finished its work.
          * 
-         * Iterate through the @waiting_for_child_ vector using an iterator. Once 
-         * the parent process is found the function pushes that back to the @ready_queue_
-         * remove the child from the parent process' @children_ vector, and finally removes
-         * the @waiting_for_children_ vector entry.
+         * Sends the process that was using the disk back to the @ready_queue_
+         * and starts the I/O of the next entry. A part of a disk group request
+         * only sends the process back once it is the last part to finish, and
+         * a write-back has no process to send back.
+         * Returns false if the disk was idle. Caller must hold @scheduler_mutex_.
          */
-        void wakeupParent(int parent_pid, int child_pid) {
-            for (vector<Process*>::iterator itr = waiting_for_child_.begin(); 
-                itr != waiting_for_child_.end(); ++itr) {
-                    if ((*itr)->getPID() == parent_pid) {
-                        ready_queue_.push_back(*itr);
-                        
-                        (*itr)->removeChild(child_pid);
-                        waiting_for_child_.erase(itr);
+        bool completeDiskUsage(int disk_number) {
+            int pid;
+            if (disks_[disk_number]->isIdle()) { return false; }
+
+            disks_[disk_number].edit().finishUsage(clock_, pid);
+
+            startBackingIo(disk_number);
+
+            if (pid == kKernelPid) {
+                writeback_completed_++;
+                return true;
+            }
 
-                        return;
-                     }
-                 }
+            if (group_requests_->count(pid) != 0) {
+                unordered_map<int, GroupRequest>::iterator itr = group_requests_.edit().find(pid);
+                if (--itr->second.parts_left_ > 0) { return true; }
+
+                DiskGroup &group = groups_[itr->second.group_];
+                group.completed_++;
+                group.latency_.record(clock_ - itr->second.made_at_);
+                group_requests_.edit().erase(itr);
+            }
+
+            processes_.pushBack(ready_queue_, pid, PROCESS_READY);
+
+            return true;
         }
 
         /**
-         * @pid: pid of the process we want to find in memory.
+         * @pid: the pid of the process whose execution will end.
          * 
-         * Iterate through @ready_queue_ if found then return true 
-         * otherwise return false.
+         * First check to see if the process has children. If there are children
+         * we signal to the children that the parent is dead and then terminate
+         * the children processes. (cascading termination) The children are
+         * handled before their parent, in the order they were forked, exactly
+         * like a recursive walk would. An explicit stack is used instead of
+         * recursion so a chain of millions of forks cannot overflow the call
+         * stack; a pid is pushed negated once its children have been pushed.
          */
-        bool inReadyQueue(int pid) {
-            for (auto &process : ready_queue_) {
-                if (process->getPID() == pid) {
-                    return true;
+        void terminateProcess(int pid) {
+            vector<int> pending(1, pid);
+
+            while (!pending.empty()) {
+                int current = pending.back();
+
+                if (current < 0) {
+                    pending.pop_back();
+                    releaseProcess(-current);
+                    continue;
+                }
+
+                pending.back() = -current;
+                size_t first = pending.size();
+
+                for (int child = processes_.releaseChildren(current); child != 0;
+                     child = processes_.nextSibling(child)) {
+                    processes_.signalParentDeath(child);
+                    pending.push_back(child);
                 }
-            }
 
-            return false;
+                reverse(pending.begin() + first, pending.end());
+            }
         }
 
         /**
-         * @pid: pid of the process we want to find in memory.
+         * @pid: process whose children were already terminated.
+         * 
+         * Release all the resources that the process may have been using. 
+         * Memory or disk usage. Only a blocked process can be in a disk queue
+         * or have a disk group request.
+         * 
+         * Then a check to see if the parent is not dead (if you terminate
+         * a child process but the parent is still alive.) If the parent is still alive
+         * check to see if it is waiting on its child to end termination. If true "wakeup"
+         * the parent (send it back to the @ready_queue_) otherwise the parent loses a child and
+         * gains a zombie. 
          * 
-         * Iterate through @waiting_for_child_ if found then return true 
-         * otherwise return false.
+         * Finally if the process is in the @ready_queue_ remove it from the @ready_queue,
+         * or from @waiting_for_child_ if it was waiting for children of its own.
          */
-        bool inWaitingVector(int pid) {
-            for (auto &process : waiting_for_child_) {
-                if (process->getPID() == pid) {
-                    return true;
+        void releaseProcess(int pid) {
+            memory_table_->releaseResources(pid);
+
+            if (processes_.state(pid) == PROCESS_BLOCKED) {
+                for (int i = 0; i < geometry_.diskCount(); i++) {
+                    if (!disks_[i]->hasEntry(pid)) { continue; }
+
+                    long using_disk = disks_[i]->frontRequestId();
+                    disks_[i].edit().releaseResources(pid, clock_);
+
+                    if (disks_[i]->frontRequestId() != using_disk) {
+                        startBackingIo(i);
+                    }
+                }
+
+                if (group_requests_->count(pid) != 0) {
+                    groups_[group_requests_->at(pid).group_].aborted_++;
+                    group_requests_.edit().erase(pid);
+                }
+            }
+
+            if (!processes_.parentDead(pid)) {
+                int parent_pid = processes_.parentOf(pid);
+
+                if (processes_.state(parent_pid) == PROCESS_WAITING) {
+                    wakeupParent(parent_pid, pid);
+                } else {
+                    processes_.addZombie(parent_pid);
+                    processes_.removeChild(parent_pid, pid);
                 }
             }
 
-            return false;
+            if (processes_.state(pid) == PROCESS_READY) {
+                processes_.erase(ready_queue_, pid);
+            } else if (processes_.state(pid) == PROCESS_WAITING) {
+                processes_.erase(waiting_for_child_, pid);
+            }
+
+            processes_.release(pid);
+        }
+
+        /**
+         * @parent_pid: the pid of the parent that needs to wake up.
+         * @child_pid: the child who is waking up the parent.
+         * 
+         * The parent process is moved from the @waiting_for_child_ queue back to
+         * the @ready_queue_ and the child is removed from its children.
+         */
+        void wakeupParent(int parent_pid, int child_pid) {
+            processes_.erase(waiting_for_child_, parent_pid);
+            processes_.pushBack(ready_queue_, parent_pid, PROCESS_READY);
+            processes_.removeChild(parent_pid, child_pid);
         }
 };
 
-#endif
\ No newline at end of file
+typedef BasicOperatingSystem<RuntimeGeometry> OperatingSystem;
+
+#endif
@@ -0,0 +1,7 @@
+/**
+ * The only translation unit of libossim.a, see ossim.h.
+ */
+#include "ossim.h"
+
+template class BasicMemoryTable<RuntimeGeometry>;
+template class BasicOperatingSystem<RuntimeGeometry>;
@@ -0,0 +1,21 @@
+/**
+ * Header file for libossim.a, the simulator as a library that can be linked
+ * into other programs. It holds the OperatingSystem (RuntimeGeometry) already
+ * compiled, so a program that includes this header and links libossim.a does
+ * not compile it again.
+ *
+ * Commands are run one at a time or in batches with submit(...) (see
+ * OsRequest in operating_system.h) and return an OsStatus; the snapshot
+ * methods return plain structs. Nothing is printed, formatting is left to the
+ * caller (the simulator's own formatting is in command_interpreter.h).
+ */
+
+#ifndef OSSIM_H
+#define OSSIM_H
+
+#include "operating_system.h"
+
+extern template class BasicMemoryTable<RuntimeGeometry>;
+extern template class BasicOperatingSystem<RuntimeGeometry>;
+
+#endif
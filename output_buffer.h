@@ -0,0 +1,133 @@
+/**
+ * Header file for the OutputBuffer class, a small buffered formatter used for
+ * the large tables the simulator prints. Rows are built in memory with plain
+ * integer conversion and padding and written to the stream in big chunks, so
+ * printing a million rows costs neither a stream manipulator nor a flush per row.
+ */
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+class OutputBuffer {
+    public:
+        /**
+         * @out: the stream the buffer is written to.
+         */
+        OutputBuffer(ostream& out) : out_(out)
+            {
+                buffer_.reserve(kFlushSize + 256);
+            }
+
+        /**
+         * Writes whatever is still buffered.
+         */
+        ~OutputBuffer() {
+            flush();
+        }
+
+        /**
+         * @text: text appended as is.
+         */
+        void append(const string& text) {
+            buffer_ += text;
+            checkSize();
+        }
+
+        /**
+         * @fill: character repeated @count times.
+         */
+        void appendFill(char fill, int count) {
+            if (count > 0) { buffer_.append(count, fill); }
+        }
+
+        /**
+         * @text: text appended and padded with spaces on the right up to @width.
+         * Same as "left << setw(width) << text".
+         */
+        void appendLeft(const string& text, int width) {
+            buffer_ += text;
+            appendFill(' ', width - (int) text.size());
+        }
+
+        void appendLeft(long value, int width) {
+            char digits[24];
+            int length = toText(value, digits);
+
+            buffer_.append(digits, length);
+            appendFill(' ', width - length);
+        }
+
+        /**
+         * @value: number padded with spaces on the left up to @width.
+         * Same as "right << setw(width) << value".
+         */
+        void appendRight(long value, int width) {
+            char digits[24];
+            int length = toText(value, digits);
+
+            appendFill(' ', width - length);
+            buffer_.append(digits, length);
+        }
+
+        /**
+         * Ends the current row. Unlike endl this does not flush the stream.
+         */
+        void newline() {
+            buffer_ += '\n';
+            checkSize();
+        }
+
+        /**
+         * Writes the buffered text to the stream.
+         */
+        void flush() {
+            if (buffer_.empty()) { return; }
+
+            out_.write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+
+    private:
+        static const size_t kFlushSize = 1 << 16;
+
+        /**
+         * @out_: the destination stream.
+         * @buffer_: text not yet written to @out_.
+         */
+        ostream& out_;
+        string buffer_;
+
+        void checkSize() {
+            if (buffer_.size() >= kFlushSize) { flush(); }
+        }
+
+        /**
+         * @value: number converted to decimal text in @digits.
+         *
+         * Returns the number of characters written.
+         */
+        static int toText(long value, char* digits) {
+            char reversed[24];
+            int length = 0;
+            bool negative = value < 0;
+            unsigned long magnitude = negative ? 0UL - (unsigned long) value : (unsigned long) value;
+
+            do {
+                reversed[length++] = (char) ('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0);
+
+            int written = 0;
+            if (negative) { digits[written++] = '-'; }
+            while (length > 0) { digits[written++] = reversed[--length]; }
+
+            return written;
+        }
+};
+
+#endif
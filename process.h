@@ -6,156 +6,419 @@
 #ifndef PROCESS_H
 #define PROCESS_H
 
-#include <memory>
-#include <vector>
+#include "cow_array.h"
 
 using namespace std;
 
 /**
- * Class for the main data structure that will simulate processes in this
- * OS simulator.
+ * Where a process currently is. A process is in at most one queue at a time:
+ * the ready queue, the waiting-for-child queue or the queue of a disk.
  */
-class Process {
+enum ProcessState {
+    PROCESS_FREE,
+    PROCESS_READY,
+    PROCESS_WAITING,
+    PROCESS_BLOCKED
+};
+
+/**
+ * Fields read on every scheduling decision. Kept in one 16 byte record so a
+ * walk of the ready queue touches a single cache line per process.
+ *
+ * @parent_pid_: pid of the parent, 1 once the parent is dead.
+ * @zombies_: number of children that ended and were not waited for yet.
+ * @state_: a ProcessState.
+ * @prev_: previous process in the queue this process is in, 0 if first.
+ * @next_: next process in the queue this process is in, 0 if last.
+ */
+struct ProcessHot {
+    int parent_pid_;
+    unsigned int zombies_ : 30;
+    unsigned int state_ : 2;
+    int prev_;
+    int next_;
+};
+
+/**
+ * Fields only needed by fork and termination. The children of a process form
+ * a list threaded through their own records so no process needs a container
+ * of its own. The first child's @prev_sibling_ points to the last child so
+ * children are appended in constant time.
+ *
+ * @first_child_: oldest living child, 0 if there are none.
+ * @prev_sibling_: previous child of the same parent (the last one for the first child).
+ * @next_sibling_: next child of the same parent, 0 if last.
+ */
+struct ProcessFamily {
+    int first_child_;
+    int prev_sibling_;
+    int next_sibling_;
+};
+
+/**
+ * A queue of processes linked through their ProcessHot records.
+ */
+struct ProcessQueue {
+    int head_;
+    int tail_;
+    int size_;
+
+    ProcessQueue() : head_{0}, tail_{0}, size_{0}
+        { }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    int front() const {
+        return head_;
+    }
+};
+
+/**
+ * Class that holds every process of the OS simulator. Processes are named by
+ * their pid and their fields live in arrays indexed by pid, so no process is
+ * a heap allocation of its own and no container holds pointers to them.
+ *
+ * The table also hands out the pids. Pid 1 is reserved for the parent of the
+ * processes made with 'A'. New pids count up from 2 to the maximum pid; after
+ * that the pids of terminated processes are reused, oldest released first,
+ * like Linux wraps around at pid_max. The arrays never hold more than the
+ * maximum pid entries no matter how many processes a run creates, and the
+ * default maximum is Linux's default pid_max so they stay small.
+ *
+ * The arrays are CowArrays (see cow_array.h), so copying a ProcessTable takes
+ * constant time and the copy shares the records until either table changes them.
+ */
+class ProcessTable {
     public:
+        static const int kDefaultMaxPid = 32768;
 
-        /** 
+        /**
          * Default constructor
          */
-        Process() : 
-            pid_{0}, parent_pid_{1}
+        ProcessTable() : max_pid_{kDefaultMaxPid}, next_pid_{2}
             { }
-        
+
+        /**
+         * @max_pid: the largest pid handed out, at least 2. Must be set before
+         * the first process is created.
+         */
+        void setMaxPid(int max_pid) {
+            max_pid_ = max_pid < 2 ? 2 : max_pid;
+        }
+
+        int maxPid() const {
+            return max_pid_;
+        }
+
         /**
-         * @pid: the pid of the new process.
          * @parent_pid: the pid of the parent.
+         *
+         * Creates a process and returns its pid, or 0 if every pid up to the
+         * maximum pid is in use. Constant time.
          */
-        Process(int pid, int parent_pid) : 
-            pid_{pid}, parent_pid_{parent_pid}
-            { }
+        int allocate(int parent_pid) {
+            int pid;
+
+            if (next_pid_ <= max_pid_) {
+                pid = next_pid_++;
+            } else if (!free_pids_.empty()) {
+                pid = popFront(free_pids_);
+            } else {
+                return 0;
+            }
+
+            create(pid, parent_pid);
+            return pid;
+        }
 
         /**
-         * Returns the process's PID
+         * @pid: process whose execution ended. It must not be in a queue.
+         *
+         * The pid joins the back of @free_pids_, linked through the record
+         * the process no longer needs.
          */
-        int getPID() {
-            return pid_;
+        void release(int pid) {
+            pushBack(free_pids_, pid, PROCESS_FREE);
+        }
+
+        ProcessState state(int pid) const {
+            return (ProcessState) hot_[pid].state_;
+        }
+
+        void setState(int pid, ProcessState state) {
+            hot_.edit(pid).state_ = state;
         }
 
         /**
          * Returns the process's parent PID
          */
-        int getParentPID() {
-            return parent_pid_;
+        int parentOf(int pid) const {
+            return hot_[pid].parent_pid_;
+        }
+
+        void signalParentDeath(int pid) {
+            hot_.edit(pid).parent_pid_ = 1;
+        }
+
+        bool parentDead(int pid) const {
+            return hot_[pid].parent_pid_ == 1;
         }
 
         /**
-         * returns @children_ vector.
+         * Returns if the process has zombies available.
          */
-        vector<int>& getChildren() {
-            return children_;
+        bool hasZombies(int pid) const {
+            return hot_[pid].zombies_ > 0;
+        }
+
+        void addZombie(int pid) {
+            hot_.edit(pid).zombies_++;
+        }
+
+        void useZombie(int pid) {
+            hot_.edit(pid).zombies_--;
         }
 
         /**
-         * Returns if the @available_zombies_ counter is
-         * greater than 0.
+         * Returns the NUMA node the process runs on.
          */
-        bool hasZombies() {
-            return available_zombies_ > 0;
+        int homeNode(int pid) const {
+            return home_nodes_[pid];
+        }
+
+        void setHomeNode(int pid, int node) {
+            home_nodes_.edit(pid) = (unsigned char) node;
         }
 
-        /** 
-         * Returns whether the @children_ vector is greater than 0.
+        /**
+         * Returns the priority of the process, its weight when the frames are
+         * divided by priority (see "memory_table.h"). 1 unless set with 'P'.
          */
-        bool hasChildren() {
-            return children_.size() > 0;
+        int priority(int pid) const {
+            return priorities_[pid];
+        }
+
+        void setPriority(int pid, int priority) {
+            priorities_.edit(pid) = priority;
         }
-        
+
         /**
-         * Increments the @available_zombies_ counter.
+         * Returns the memory references of the process, only counted while
+         * quotas are on.
          */
-        void addZombie() {
-            available_zombies_++;
+        long references(int pid) const {
+            return references_[pid];
+        }
+
+        void countReference(int pid) {
+            references_.edit(pid)++;
         }
 
         /**
-         * Decrements the @available_zombies_ counter.
+         * Returns how many processes had @pid so far, which tells a process
+         * apart from a later one that got its pid again.
          */
-        void useZombie() {
-            available_zombies_--;
+        unsigned generation(int pid) const {
+            return generations_[pid];
+        }
+
+        bool hasChildren(int pid) const {
+            return family_[pid].first_child_ != 0;
         }
 
         /**
-         * @child_pid: the pid that will be removed from the @children_
-         * vector.
-         * 
-         * Iterate through @children_ vector and removes the entry that matches
-         * @pid.
+         * @parent: process that gains a child.
+         * @child: the new child, appended after the parent's other children.
          */
-        void removeChild(int child_pid) {
-            for (vector<int>::iterator itr = children_.begin(); 
-                 itr != children_.end(); ++itr) {
-                     if ((*itr) == child_pid) {
-                         children_.erase(itr);
-                         return;
-                     }
-                 }
+        void addChild(int parent, int child) {
+            ProcessFamily &family = family_.edit(parent);
+            ProcessFamily &added = family_.edit(child);
+
+            added.next_sibling_ = 0;
+
+            if (family.first_child_ == 0) {
+                family.first_child_ = child;
+                added.prev_sibling_ = child;
+            } else {
+                int first = family.first_child_;
+                int last = family_[first].prev_sibling_;
+
+                family_.edit(last).next_sibling_ = child;
+                added.prev_sibling_ = last;
+                family_.edit(first).prev_sibling_ = child;
+            }
         }
 
         /**
-         * @child_pid: pid that will be used inserted to the @children_ vector.
+         * @parent: process that loses a child.
+         * @child: the child that will be unlinked, in constant time.
          */
-        void spawnChildProc(int child_pid) {
-            children_.push_back(child_pid);
+        void removeChild(int parent, int child) {
+            ProcessFamily &family = family_.edit(parent);
+            ProcessFamily &removed = family_.edit(child);
+            int first = family.first_child_;
+
+            if (child == first) {
+                family.first_child_ = removed.next_sibling_;
+                if (removed.next_sibling_ != 0) {
+                    family_.edit(removed.next_sibling_).prev_sibling_ = removed.prev_sibling_;
+                }
+            } else {
+                family_.edit(removed.prev_sibling_).next_sibling_ = removed.next_sibling_;
+                if (removed.next_sibling_ != 0) {
+                    family_.edit(removed.next_sibling_).prev_sibling_ = removed.prev_sibling_;
+                } else {
+                    family_.edit(first).prev_sibling_ = removed.prev_sibling_;
+                }
+            }
+
+            removed.prev_sibling_ = 0;
+            removed.next_sibling_ = 0;
         }
 
-        void signalParentDeath() {
-            parent_dead_ = true;
+        /**
+         * @pid: process whose children are handed to the caller.
+         *
+         * Returns the first child; the others follow through nextSibling(...).
+         * The parent forgets all of them so the caller can terminate them
+         * without changing the list it walks.
+         */
+        int releaseChildren(int pid) {
+            int first = family_[pid].first_child_;
+            family_.edit(pid).first_child_ = 0;
+
+            return first;
         }
 
-        bool parentDead() {
-            if (parent_pid_ == 1) {
-                return true;
+        int nextSibling(int pid) const {
+            return family_[pid].next_sibling_;
+        }
+
+        /**
+         * @queue: queue the process joins at the back.
+         * @pid: the process.
+         * @state: the state the process is in while in @queue.
+         */
+        void pushBack(ProcessQueue& queue, int pid, ProcessState state) {
+            ProcessHot &hot = hot_.edit(pid);
+
+            hot.state_ = state;
+            hot.prev_ = queue.tail_;
+            hot.next_ = 0;
+
+            if (queue.tail_ != 0) {
+                hot_.edit(queue.tail_).next_ = pid;
+            } else {
+                queue.head_ = pid;
             }
 
-            return parent_dead_;
+            queue.tail_ = pid;
+            queue.size_++;
+        }
+
+        /**
+         * @queue: a queue that is not empty.
+         *
+         * Removes and returns the process at the front of @queue.
+         */
+        int popFront(ProcessQueue& queue) {
+            int pid = queue.head_;
+            erase(queue, pid);
+
+            return pid;
         }
 
-        /** 
-         * @out: output stream.
-         * @process: process that will be printed.
-         * 
-         * Overloaded output operator so the processes can be printed.
+        /**
+         * @queue: the queue @pid is in.
+         * @pid: process removed from @queue in constant time.
          */
-        friend ostream& operator<< (ostream& out, Process &process) {
-            out << "Process " << process.pid_;
-            
-            return out;
+        void erase(ProcessQueue& queue, int pid) {
+            ProcessHot &hot = hot_.edit(pid);
+
+            if (hot.prev_ != 0) {
+                hot_.edit(hot.prev_).next_ = hot.next_;
+            } else {
+                queue.head_ = hot.next_;
+            }
+
+            if (hot.next_ != 0) {
+                hot_.edit(hot.next_).prev_ = hot.prev_;
+            } else {
+                queue.tail_ = hot.prev_;
+            }
+
+            hot.prev_ = 0;
+            hot.next_ = 0;
+            queue.size_--;
         }
 
         /**
-         * @rhs: right hand process
-         * @lhs: left hand process
-         * 
-         * Overloaded equality operator. If both PIDs are the same
-         * then processes are the same.
+         * Returns the process after @pid in its queue, 0 if @pid is the last one.
          */
-        friend bool operator== (Process rhs, Process lhs) {
-            return rhs.pid_ == lhs.pid_;
+        int next(int pid) const {
+            return hot_[pid].next_;
         }
 
     private:
         /**
-         * @pid_: pid of the process
-         * @parent_pid_: pid of the parent.
-         * @available_zombies_: counter to kepe track of the process's
-         * abailable number of zombies.
-         * @children_: vector that holds all the pid of this process's children.
-         */
-        int pid_;
-        int parent_pid_;
-        int available_zombies_;
-        bool parent_dead_;
-        vector<int> children_;
+         * @hot_: the scheduling fields of every process, indexed by pid.
+         * @family_: the parent and child links of every process, indexed by pid.
+         * @home_nodes_: the NUMA node of every process, indexed by pid.
+         * @priorities_: the priority of every process, indexed by pid.
+         * @references_: the memory references of every process, indexed by pid.
+         * @generations_: the number of processes every pid was given to.
+         * @max_pid_: the largest pid handed out.
+         * @next_pid_: the smallest pid that was never used.
+         * @free_pids_: pids of terminated processes, in the order they were released.
+         */
+        CowArray<ProcessHot> hot_;
+        CowArray<ProcessFamily> family_;
+        CowArray<unsigned char> home_nodes_;
+        CowArray<int> priorities_;
+        CowArray<long> references_;
+        CowArray<unsigned> generations_;
+        int max_pid_;
+        int next_pid_;
+        ProcessQueue free_pids_;
+
+        /**
+         * @pid: the pid of the new process.
+         * @parent_pid: the pid of the parent.
+         *
+         * Resets the fields of @pid. The arrays grow a chunk at a time and
+         * never move their records, so the spare capacity stays small with
+         * millions of processes.
+         */
+        void create(int pid, int parent_pid) {
+            if (pid >= (int) hot_.size()) {
+                hot_.resize(pid + 1);
+                family_.resize(pid + 1);
+                home_nodes_.resize(pid + 1);
+                priorities_.resize(pid + 1);
+                references_.resize(pid + 1);
+                generations_.resize(pid + 1);
+            }
+
+            home_nodes_.edit(pid) = 0;
+            priorities_.edit(pid) = 1;
+            references_.edit(pid) = 0;
+            generations_.edit(pid)++;
+
+            ProcessHot &hot = hot_.edit(pid);
+            hot.parent_pid_ = parent_pid;
+            hot.zombies_ = 0;
+            hot.state_ = PROCESS_FREE;
+            hot.prev_ = 0;
+            hot.next_ = 0;
+
+            ProcessFamily &family = family_.edit(pid);
+            family.first_child_ = 0;
+            family.prev_sibling_ = 0;
+            family.next_sibling_ = 0;
+        }
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,329 @@
+/**
+ * Header file for the record and replay harness. A trace is a list of
+ * commands of the simulator's command language. Recording runs it once and
+ * keeps a digest of what every command did and of the full state at regular
+ * checkpoints, plus the throughput of the trace. Replaying runs the trace on
+ * a new build and checks that every digest is the same bit for bit and that
+ * the throughput did not regress, so a faster MemoryTable, Disk or scheduler
+ * can be checked against the code it replaces.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "command_interpreter.h"
+
+using namespace std;
+
+/**
+ * A 64-bit FNV-1a hash, folded over everything that is added to it.
+ */
+struct TraceDigest {
+    unsigned long long hash_;
+
+    TraceDigest() : hash_{14695981039346656037ULL}
+        { }
+
+    void add(const string& bytes) {
+        for (size_t i = 0; i < bytes.size(); i++) {
+            hash_ ^= (unsigned char) bytes[i];
+            hash_ *= 1099511628211ULL;
+        }
+    }
+
+    void add(long value) {
+        for (int i = 0; i < 8; i++) {
+            hash_ ^= (unsigned char) (value >> (i * 8));
+            hash_ *= 1099511628211ULL;
+        }
+    }
+};
+
+/**
+ * Struct for one checkpoint of a recorded trace.
+ *
+ * @command_: number of commands run when the checkpoint was taken.
+ * @steps_: digest of the output, status and running process of every command
+ * up to @command_.
+ * @state_: digest of every snapshot ('S r', 'S i', 'S s', 'S n', 'S q' and
+ * 'S m') after @command_.
+ */
+struct ReplayCheckpoint {
+    long command_;
+    unsigned long long steps_;
+    unsigned long long state_;
+};
+
+/**
+ * Struct that holds a recorded trace, as saved in a record file.
+ *
+ * @commands_: number of commands of the trace.
+ * @interval_: commands between two checkpoints. The last command always
+ * gets one.
+ * @throughput_: commands/sec of the best timed run.
+ * @checkpoints_: the checkpoints, in order.
+ */
+struct ReplayRecord {
+    long commands_;
+    int interval_;
+    double throughput_;
+    vector<ReplayCheckpoint> checkpoints_;
+
+    ReplayRecord() : commands_{0}, interval_{0}, throughput_{0}
+        { }
+
+    /**
+     * @path: the record file that is written.
+     *
+     * Returns false if the file could not be written.
+     */
+    bool save(const string& path) const {
+        ofstream file(path.c_str());
+
+        file << "ossim-replay 1" << endl;
+        file << "commands " << commands_ << endl;
+        file << "interval " << interval_ << endl;
+        file << "throughput " << (long) throughput_ << endl;
+
+        for (auto &checkpoint : checkpoints_) {
+            file << "checkpoint " << checkpoint.command_ << " " << hex << checkpoint.steps_ << " ";
+            file << checkpoint.state_ << dec << endl;
+        }
+
+        return file.good();
+    }
+
+    /**
+     * @path: the record file that is read.
+     *
+     * Returns false if the file cannot be read or is not a record file.
+     */
+    bool load(const string& path) {
+        ifstream file(path.c_str());
+        string magic, version, key;
+
+        if (!(file >> magic >> version) || magic != "ossim-replay" || version != "1") { return false; }
+        if (!(file >> key >> commands_) || key != "commands") { return false; }
+        if (!(file >> key >> interval_) || key != "interval") { return false; }
+        if (!(file >> key >> throughput_) || key != "throughput") { return false; }
+
+        checkpoints_.clear();
+        ReplayCheckpoint checkpoint;
+
+        while (file >> key >> checkpoint.command_ >> hex >> checkpoint.steps_ >> checkpoint.state_ >> dec) {
+            if (key != "checkpoint") { return false; }
+            checkpoints_.push_back(checkpoint);
+        }
+
+        return file.eof();
+    }
+};
+
+/**
+ * Class that records and replays a trace against an OperatingSystem. Every run
+ * of the trace, digested or timed, is made on a branch of the OS (see
+ * OperatingSystem::branch()), so they all start from the same state and the
+ * OS itself is never changed. The OS must have no BackingStore or swap area.
+ *
+ * Works with any BasicOperatingSystem (see operating_system.h), so a trace
+ * recorded on a compiled profile can be replayed with --profiles off and the
+ * other way around.
+ */
+template <class OS>
+class TraceReplayer {
+    public:
+        /**
+         * Timed runs of the trace, the fastest one is its throughput.
+         */
+        static const int kTimedRuns = 5;
+
+        /**
+         * @os: the operating system in the state the trace starts from.
+         * @commands: the trace, one command per element. A 'bsod' ends it.
+         */
+        TraceReplayer(OS& os, const vector<string>& commands) : os_(os), commands_(commands)
+            { }
+
+        /**
+         * @interval: commands between two checkpoints, at least 1.
+         * @result: receives the digests and the throughput of the trace.
+         *
+         * Returns false if the OS cannot be branched.
+         */
+        bool record(int interval, ReplayRecord& result) {
+            result.interval_ = interval < 1 ? 1 : interval;
+
+            return digest(result) && time(result.throughput_);
+        }
+
+        /**
+         * @expected: the record the trace is checked against.
+         * @max_regression: the most the throughput may drop below the one
+         * of @expected, in percent.
+         * @out: receives the outcome.
+         *
+         * Returns false if a digest differs or the throughput regressed by
+         * more than @max_regression.
+         */
+        bool verify(const ReplayRecord& expected, double max_regression, ostream& out) {
+            ReplayRecord actual;
+            actual.interval_ = expected.interval_;
+
+            if (!digest(actual) || !time(actual.throughput_)) {
+                out << "Cannot replay a trace with a backing store or a swap area" << endl;
+                return false;
+            }
+
+            if (actual.commands_ != expected.commands_) {
+                out << "MISMATCH: the trace has " << actual.commands_ << " commands, the record ";
+                out << expected.commands_ << endl;
+                return false;
+            }
+
+            long previous = 0;
+
+            for (size_t i = 0; i < expected.checkpoints_.size() && i < actual.checkpoints_.size(); i++) {
+                const ReplayCheckpoint &want = expected.checkpoints_[i];
+                const ReplayCheckpoint &got = actual.checkpoints_[i];
+
+                if (want.steps_ != got.steps_) {
+                    out << "MISMATCH: a command between " << previous + 1 << " and " << got.command_;
+                    out << " produced a different result" << endl;
+                    return false;
+                } else if (want.state_ != got.state_) {
+                    out << "MISMATCH: the state after command " << got.command_ << " differs" << endl;
+                    return false;
+                }
+                previous = got.command_;
+            }
+
+            if (actual.checkpoints_.size() != expected.checkpoints_.size()) {
+                out << "MISMATCH: " << actual.checkpoints_.size() << " checkpoints, the record has ";
+                out << expected.checkpoints_.size() << endl;
+                return false;
+            }
+
+            double change = expected.throughput_ > 0 ?
+                            (actual.throughput_ / expected.throughput_ - 1) * 100 : 0;
+
+            out << "Replay: " << actual.commands_ << " commands, " << actual.checkpoints_.size();
+            out << " checkpoints match" << endl;
+            out << "Throughput: " << (long) actual.throughput_ << " commands/sec (baseline ";
+            out << (long) expected.throughput_ << ", " << (change >= 0 ? "+" : "") << change << "%)" << endl;
+
+            if (-change > max_regression) {
+                out << "REGRESSION: throughput dropped by more than " << max_regression << "%" << endl;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        OS& os_;
+        const vector<string>& commands_;
+
+        /**
+         * @record: receives the number of commands and a checkpoint every
+         * @record.interval_ commands and after the last one.
+         *
+         * Runs the trace once, digesting the output, status and running
+         * process of every command. Returns false if the OS cannot be branched.
+         */
+        bool digest(ReplayRecord& record) {
+            OS* run = os_.branch();
+            if (run == nullptr) { return false; }
+
+            ostringstream output;
+            CommandInterpreter<OS> interpreter{*run, output};
+            TraceDigest steps;
+
+            record.commands_ = 0;
+            record.checkpoints_.clear();
+
+            for (auto &command : commands_) {
+                CommandStatus status = interpreter.execute(command);
+                if (status == COMMAND_SHUTDOWN) { break; }
+
+                steps.add(output.str());
+                steps.add((long) status);
+                steps.add((long) run->runningProcess());
+                output.str("");
+
+                record.commands_++;
+                if (record.commands_ % record.interval_ == 0) {
+                    record.checkpoints_.push_back(ReplayCheckpoint{record.commands_, steps.hash_, stateOf(*run)});
+                }
+            }
+
+            if (record.commands_ % record.interval_ != 0) {
+                record.checkpoints_.push_back(ReplayCheckpoint{record.commands_, steps.hash_, stateOf(*run)});
+            }
+
+            delete run;
+            return true;
+        }
+
+        /**
+         * @os: the OS whose state is digested.
+         *
+         * Returns the digest of every snapshot of @os. The snapshots are taken
+         * on a branch, since the commands advance the clock and 'S m' resets
+         * the frames 'S m +' shows.
+         */
+        unsigned long long stateOf(OS& os) {
+            OS* view = os.branch();
+            ostringstream text;
+            CommandInterpreter<OS> interpreter{*view, text};
+            TraceDigest state;
+
+            for (auto &command : {"S r", "S i", "S s", "S n", "S q", "S m"}) {
+                interpreter.execute(command);
+            }
+
+            state.add(text.str());
+            delete view;
+
+            return state.hash_;
+        }
+
+        /**
+         * @throughput: receives the commands/sec of the fastest of kTimedRuns
+         * runs of the trace. Their output is discarded.
+         *
+         * Returns false if the OS cannot be branched.
+         */
+        bool time(double& throughput) {
+            throughput = 0;
+
+            for (int i = 0; i < kTimedRuns; i++) {
+                OS* run = os_.branch();
+                if (run == nullptr) { return false; }
+
+                ostream discard(nullptr);
+                CommandInterpreter<OS> interpreter{*run, discard};
+                long commands = 0;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+                for (auto &command : commands_) {
+                    if (interpreter.execute(command) == COMMAND_SHUTDOWN) { break; }
+                    commands++;
+                }
+
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                if (seconds > 0 && commands / seconds > throughput) { throughput = commands / seconds; }
+
+                delete run;
+            }
+
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Scalability benchmark for the thread-safe OperatingSystem. Runs the same
+ * command mix from 1 up to N threads against one shared OperatingSystem and
+ * prints the throughput for every thread count.
+ *
+ * Then warms up one OperatingSystem, branches it 1 up to N times (see
+ * OperatingSystem::branch()) and runs the mix on every branch in a thread of
+ * its own, printing the time a branch took and the throughput of all of them.
+ *
+ * Usage:
+ *     ./scalebench [max threads] [commands per thread] [frames] [disks]
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ossim.h"
+
+using namespace std;
+
+/**
+ * @os: the shared operating system.
+ * @thread_id: index of this thread, used to pick a disk and vary addresses.
+ * @commands: number of commands this thread runs.
+ * @disk_count: number of disks of @os.
+ * @address_space: addresses are drawn from [0, @address_space).
+ *
+ * Mostly memory references, with a disk request and completion and a
+ * preemption mixed in every 16 commands.
+ */
+void runCommands(OperatingSystem* os, int thread_id, long commands, int disk_count, long address_space) {
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL * (thread_id + 1);
+    int disk = thread_id % disk_count;
+
+    for (long i = 0; i < commands; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        switch (i % 16) {
+            case 5:
+                os->useDisk(disk, "bench");
+                break;
+            case 6:
+                os->finishDiskUsage(disk);
+                break;
+            case 11:
+                os->preemptProcess();
+                break;
+            default:
+                os->useMemory((int) ((seed >> 33) % address_space));
+                break;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? stoi(argv[1]) : (int) thread::hardware_concurrency();
+    long commands = argc > 2 ? stol(argv[2]) : 200000;
+    int frames = argc > 3 ? stoi(argv[3]) : 4096;
+    int disks = argc > 4 ? stoi(argv[4]) : 4;
+    int page_size = 4096;
+    long address_space = (long) frames * page_size * 2;
+
+    if (max_threads < 1) { max_threads = 1; }
+    if (address_space > 2000000000) { address_space = 2000000000; }
+
+    cout << "Threads  Commands/sec  Speedup" << endl;
+    double single = 0;
+
+    for (int threads = 1; threads <= max_threads; threads++) {
+        OperatingSystem os{(long) frames * page_size, page_size, disks};
+
+        for (int i = 0; i < threads * 4; i++) {
+            os.spawnProcess();
+        }
+
+        vector<thread> workers;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(thread(runCommands, &os, i, commands, disks, address_space));
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double throughput = threads * commands / seconds;
+        if (threads == 1) { single = throughput; }
+
+        cout << threads << "\t " << (long) throughput << "\t       " << throughput / single << endl;
+    }
+
+    OperatingSystem warm{(long) frames * page_size, page_size, disks};
+
+    for (int i = 0; i < max_threads * 4; i++) {
+        warm.spawnProcess();
+    }
+    runCommands(&warm, 0, commands, disks, address_space);
+
+    cout << endl << "Branches  Branch (us)  Commands/sec" << endl;
+
+    for (int branches = 1; branches <= max_threads; branches++) {
+        vector<OperatingSystem*> copies;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (int i = 0; i < branches; i++) {
+            copies.push_back(warm.branch());
+        }
+
+        double branch_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        vector<thread> workers;
+        start = chrono::steady_clock::now();
+
+        for (int i = 0; i < branches; i++) {
+            workers.push_back(thread(runCommands, copies[i], i + 1, commands, disks, address_space));
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << branches << "\t  " << branch_us / branches << "\t       ";
+        cout << (long) (branches * commands / seconds) << endl;
+
+        for (auto &copy : copies) {
+            delete copy;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,364 @@
+/**
+ * Header file for the SimulatorServer class. Runs a single OperatingSystem as a
+ * daemon that listens on a Unix domain socket and serves any number of clients
+ * at once through epoll.
+ *
+ * Clients send the normal command language, one command per line, and may
+ * pipeline as many lines as they like. Every command gets exactly one reply in
+ * the order the commands were sent:
+ *
+ *     <status> <length>\n<length bytes of output>
+ *
+ * where <status> is OK, ERR (the command failed) or INVALID. Besides the
+ * simulator commands the server understands 'stats' (throughput counters),
+ * 'quit' (close this connection) and 'bsod' (stop the server).
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "command_interpreter.h"
+#include "operating_system.h"
+
+using namespace std;
+
+/**
+ * Struct that holds the buffered input and output of one client.
+ */
+struct ClientConnection {
+    string in_buffer_;
+    string out_buffer_;
+    bool closing_;
+
+    ClientConnection() : closing_{false}
+        { }
+};
+
+/**
+ * Works with any BasicOperatingSystem (see operating_system.h).
+ */
+template <class OS>
+class SimulatorServer {
+    public:
+        /**
+         * @os: the operating system shared by all clients.
+         * @socket_path: path of the Unix domain socket to listen on.
+         */
+        SimulatorServer(OS& os, string socket_path) :
+            os_(os), interpreter_(os, output_), socket_path_{socket_path}, listen_fd_{-1},
+            epoll_fd_{-1}, running_{false}, commands_{0}, total_clients_{0}
+            { }
+
+        /**
+         * Closes every connection and removes the socket file.
+         */
+        ~SimulatorServer() {
+            for (auto &client : clients_) {
+                close(client.first);
+            }
+
+            if (listen_fd_ >= 0) {
+                close(listen_fd_);
+                unlink(socket_path_.c_str());
+            }
+
+            if (epoll_fd_ >= 0) { close(epoll_fd_); }
+        }
+
+        /**
+         * Creates, binds and listens on the socket. Returns false and reports the
+         * error if any step fails.
+         */
+        bool start() {
+            struct sockaddr_un address;
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+
+            if (socket_path_.size() >= sizeof(address.sun_path)) {
+                cout << "ERROR: socket path is too long" << endl;
+                return false;
+            }
+            strncpy(address.sun_path, socket_path_.c_str(), sizeof(address.sun_path) - 1);
+
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            unlink(socket_path_.c_str());
+
+            if (listen_fd_ < 0 ||
+                bind(listen_fd_, (struct sockaddr*) &address, sizeof(address)) < 0 ||
+                listen(listen_fd_, SOMAXCONN) < 0) {
+                cout << "ERROR: could not listen on " << socket_path_ << ": " << strerror(errno) << endl;
+                return false;
+            }
+
+            epoll_fd_ = epoll_create1(0);
+            if (epoll_fd_ < 0) { return false; }
+
+            watch(listen_fd_, EPOLLIN);
+            return true;
+        }
+
+        /**
+         * Main event loop. Accepts new clients, runs every complete line a client
+         * sent and writes back the replies. Runs until a client sends 'bsod'.
+         */
+        void run() {
+            struct epoll_event events[kMaxEvents];
+
+            running_ = true;
+            started_ = chrono::steady_clock::now();
+
+            while (running_) {
+                int ready = epoll_wait(epoll_fd_, events, kMaxEvents, kPollMillis);
+
+                os_.pollDiskCompletions();
+
+                for (int i = 0; i < ready; i++) {
+                    int fd = events[i].data.fd;
+
+                    if (fd == listen_fd_) {
+                        acceptClients();
+                        continue;
+                    }
+
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                        readClient(fd);
+                    }
+
+                    if (clients_.count(fd) && (events[i].events & EPOLLOUT)) {
+                        flushClient(fd);
+                    }
+                }
+            }
+
+            cout << throughputReport();
+        }
+
+    private:
+        static const int kMaxEvents = 64;
+        static const int kPollMillis = 10;
+
+        /**
+         * Most bytes of an unfinished line kept for a client. A client that
+         * sends a longer line is disconnected.
+         */
+        static const size_t kMaxInputBuffer = 1 << 20;
+
+        /**
+         * @os_: the operating system shared by all clients.
+         * @output_: receives the output of the command being run.
+         * @interpreter_: runs the commands against @os_, writing to @output_.
+         * @socket_path_: path of the listening socket.
+         * @listen_fd_: the listening socket.
+         * @epoll_fd_: the epoll instance.
+         * @running_: set to false by 'bsod'.
+         * @clients_: every open connection keyed by its file descriptor.
+         * @commands_: number of commands run for all clients.
+         * @total_clients_: number of clients that ever connected.
+         * @started_: time the event loop started.
+         */
+        OS& os_;
+        ostringstream output_;
+        CommandInterpreter<OS> interpreter_;
+        string socket_path_;
+        int listen_fd_;
+        int epoll_fd_;
+        bool running_;
+        map<int, ClientConnection> clients_;
+        long commands_;
+        long total_clients_;
+        chrono::steady_clock::time_point started_;
+
+        void watch(int fd, unsigned events) {
+            struct epoll_event event;
+            event.events = events;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        void rewatch(int fd, unsigned events) {
+            struct epoll_event event;
+            event.events = events;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+        }
+
+        void acceptClients() {
+            while (true) {
+                int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK);
+                if (fd < 0) { return; }
+
+                clients_[fd] = ClientConnection();
+                total_clients_++;
+                watch(fd, EPOLLIN);
+            }
+        }
+
+        void closeClient(int fd) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            clients_.erase(fd);
+        }
+
+        /**
+         * @fd: the client that has data available.
+         *
+         * Reads everything the client sent, runs every complete line in order and
+         * queues the replies. Partial lines stay in the buffer until the rest
+         * arrives, or are run as the last line when the client closes. A client
+         * whose partial line grows past kMaxInputBuffer is disconnected.
+         */
+        void readClient(int fd) {
+            ClientConnection &client = clients_[fd];
+            char buffer[65536];
+
+            while (!client.closing_) {
+                ssize_t count = read(fd, buffer, sizeof(buffer));
+
+                if (count > 0) {
+                    client.in_buffer_.append(buffer, count);
+                    runLines(client);
+
+                    if (client.in_buffer_.size() > kMaxInputBuffer) {
+                        closeClient(fd);
+                        return;
+                    }
+                    continue;
+                }
+
+                if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    client.closing_ = true;
+
+                    if (!client.in_buffer_.empty()) {
+                        client.in_buffer_ += '\n';
+                        runLines(client);
+                    }
+                }
+                break;
+            }
+
+            flushClient(fd);
+        }
+
+        /**
+         * @client: the client whose input buffer is run.
+         *
+         * Runs every complete line of the input buffer in order and removes
+         * them from it. A "quit" closes the client and drops what follows.
+         */
+        void runLines(ClientConnection& client) {
+            size_t start = 0;
+            size_t end;
+            while (running_ && (end = client.in_buffer_.find('\n', start)) != string::npos) {
+                string line = client.in_buffer_.substr(start, end - start);
+                start = end + 1;
+
+                if (!line.empty() && line[line.size() - 1] == '\r') {
+                    line.erase(line.size() - 1);
+                }
+
+                if (line == "quit") {
+                    client.closing_ = true;
+                    client.in_buffer_.clear();
+                    return;
+                }
+
+                runLine(client, line);
+            }
+            client.in_buffer_.erase(0, start);
+        }
+
+        /**
+         * @client: the client that sent the line.
+         * @line: one command.
+         *
+         * Runs the command and appends the reply, with the output the
+         * interpreter wrote to @output_, to the client's output buffer.
+         */
+        void runLine(ClientConnection& client, string line) {
+            string status = "OK";
+            output_.str("");
+
+            if (line == "stats") {
+                output_ << throughputReport();
+            } else {
+                CommandStatus result = interpreter_.execute(line);
+
+                if (result == COMMAND_SHUTDOWN) {
+                    running_ = false;
+                } else if (result == COMMAND_INVALID) {
+                    status = "INVALID";
+                } else if (result == COMMAND_FAILED) {
+                    status = "ERR";
+                }
+                commands_++;
+            }
+
+            string payload = output_.str();
+            client.out_buffer_ += status + " " + to_string(payload.size()) + "\n";
+            client.out_buffer_ += payload;
+        }
+
+        /**
+         * @fd: the client whose replies are written.
+         *
+         * Writes as much of the output buffer as the socket accepts. If some is
+         * left the client is watched for EPOLLOUT until it drains.
+         */
+        void flushClient(int fd) {
+            ClientConnection &client = clients_[fd];
+
+            while (!client.out_buffer_.empty()) {
+                ssize_t count = send(fd, client.out_buffer_.data(), client.out_buffer_.size(), MSG_NOSIGNAL);
+
+                if (count < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+
+                    closeClient(fd);
+                    return;
+                }
+                client.out_buffer_.erase(0, count);
+            }
+
+            if (client.out_buffer_.empty()) {
+                if (client.closing_) {
+                    closeClient(fd);
+                } else {
+                    rewatch(fd, EPOLLIN);
+                }
+            } else {
+                rewatch(fd, EPOLLIN | EPOLLOUT);
+            }
+        }
+
+        /**
+         * Returns the command counters and the commands/sec measured since the
+         * server started.
+         */
+        string throughputReport() {
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - started_).count();
+            ostringstream report;
+
+            report << "Commands: " << commands_ << endl;
+            report << "Clients: " << clients_.size() << " connected, " << total_clients_ << " total" << endl;
+            report << "Uptime: " << seconds << " s" << endl;
+            report << "Throughput: " << (seconds > 0 ? commands_ / seconds : 0) << " commands/sec" << endl;
+
+            return report.str();
+        }
+};
+
+#endif
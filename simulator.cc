@@ -2,114 +2,415 @@
  * Main execution code for simulator. First initial prompt assumes 
  * perfect input (ONLY NUMBERS). 
  * 
- * This driver program takes the commands from the standard input and if 
- * the first piece of the input matches a particular criteria that needs a
- * number i.e m <num> we take the second value place it into a stringstream
- * and then push that stringstream into an integer value. If the command receives
- * something that is not wanted the command is invalid and the user is informed.
+ * This driver program takes the commands from the standard input and hands
+ * each line to the CommandInterpreter (see command_interpreter.h), or serves
+ * them to socket clients when run in server mode (see server.h).
+ *
+ * Optional arguments:
+ *     --memory <bytes>     memory amount, skips the prompt when given with the two below.
+ *     --page-size <bytes>  page size.
+ *     --disks <n>          number of disks.
+ *     --serve <socket>     run as a daemon on the Unix domain socket <socket>
+ *                          instead of reading commands from the standard input.
+ *     --backing-dir <dir>  map every disk to <dir>/disk<n> and perform real file I/O.
+ *     --io-size <bytes>    number of bytes read or written per disk request.
+ *     --io-workers <n>     worker threads used when io_uring is unavailable.
+ *     --swap-file <path>   write evicted pages to a swap area backed by <path>.
+ *     --swap-slots <n>     number of pages the swap area can hold.
+ *     --swap-in-us <n>     modeled latency of a swap in (major fault).
+ *     --swap-out-us <n>    modeled latency of a swap out.
+ *     --numa-nodes <n>     split the memory into <n> NUMA nodes.
+ *     --numa-policy <p>    first-touch (default) or interleave page placement.
+ *     --numa-local-ns <n>  modeled cost of a reference to the home node.
+ *     --numa-remote-ns <n> modeled cost of a reference to another node.
+ *     --numa-migrate <n>   migrate a page after <n> remote references, 0 for never.
+ *     --disk-group <raid0|raid1>:<disk>,<disk>,...
+ *                          add a striped or mirrored group of disks, numbered
+ *                          after the physical disks. May be given more than once.
+ *     --prefetch <n>       prefetch up to <n> pages of a sequential stream per fault.
+ *     --max-pid <n>        largest pid; pids of ended processes are reused after it.
+ *     --writeback-disk <n|off>
+ *                          disk that receives the write-back of dirty pages (default 0).
+ *     --writeback-batch <n> most dirty pages written by one write-back request (default 8).
+ *     --dirty-ratio <n>    percentage of dirty frames above which the flusher
+ *                          cleans pages ahead of eviction (default 20).
+ *     --buffer-cache <n>   cache up to <n> disk blocks so reads of them skip the disk.
+ *     --cache-policy <p>   lru (default) or 2q, which block the buffer cache evicts.
+ *     --quantum <n>        preempt the running process after a time slice of <n>.
+ *     --quantum-unit <u>   ticks (default) or refs, what the time slice counts.
+ *     --quota <p>          off (default), proportional or priority: how the frames
+ *                          are divided between the processes.
+ *     --replacement <s>    global (default) or local: whether a process at its
+ *                          quota replaces its own pages.
+ *     --profiles off       always use the run time configured simulator.
+ *     --record <file>      run the commands of the standard input as a trace and
+ *                          save its digests and throughput to <file> (see replay.h).
+ *     --replay <file>      run the trace again and check it against <file>.
+ *     --max-regression <n> percentage the throughput may drop below the recorded
+ *                          one before --replay fails (default 10).
+ *     --checkpoint-every <n>
+ *                          commands between two snapshots of the state in the
+ *                          record (default 1000).
+ *
+ * Configurations that match one of the compiled profiles below run on an
+ * OperatingSystem specialized for that geometry (see geometry.h).
  */
 #include <iostream>
 #include <string>
 #include <sstream>
 
+#include "command_interpreter.h"
 #include "helpers.h"
-#include "operating_system.h"
+#include "ossim.h"
+#include "replay.h"
+#include "server.h"
 
 using namespace std;
 
-int main() {
-    stringstream s_stream;
-    long memory_{0};
-    int page_{0}, disk_{0};
+/**
+ * Struct that holds everything given on the command line or at the prompt.
+ */
+struct SimulatorOptions {
+    long memory_;
+    int page_;
+    int disk_;
+    string backing_dir_;
+    long io_size_;
+    int io_workers_;
+    string swap_file_;
+    int swap_slots_;
+    int swap_in_us_;
+    int swap_out_us_;
+    string socket_path_;
+    int max_pid_;
+    int prefetch_;
+    int writeback_disk_;
+    int writeback_batch_;
+    int dirty_ratio_;
+    int cache_blocks_;
+    CachePolicy cache_policy_;
+    long quantum_;
+    QuantumUnit quantum_unit_;
+    QuotaConfig quota_;
+    NumaConfig numa_;
+    vector<string> disk_groups_;
+    bool use_profiles_;
+    string record_path_;
+    string replay_path_;
+    int max_regression_;
+    int checkpoint_interval_;
+
+    SimulatorOptions() :
+        memory_{0}, page_{0}, disk_{0}, io_size_{4096}, io_workers_{4},
+        swap_slots_{1000000}, swap_in_us_{100}, swap_out_us_{100}, max_pid_{0},
+        prefetch_{0}, writeback_disk_{0}, writeback_batch_{8}, dirty_ratio_{20},
+        cache_blocks_{0}, cache_policy_{CACHE_LRU}, quantum_{0}, quantum_unit_{QUANTUM_TICKS}, use_profiles_{true},
+        max_regression_{10}, checkpoint_interval_{1000}
+        { }
+};
+
+/**
+ * Profiles compiled with a FixedGeometry. A configuration that matches one of
+ * them exactly runs on the specialized simulator, anything else falls back to
+ * the run time configured OperatingSystem.
+ */
+typedef FixedGeometry<4096, 1024, 2> SmallProfile;      /* 4 MiB, 2 disks */
+typedef FixedGeometry<4096, 16384, 2> MediumProfile;    /* 64 MiB, 2 disks */
+typedef FixedGeometry<4096, 262144, 4> LargeProfile;    /* 1 GiB, 4 disks */
+
+/**
+ * @options: the configuration that was entered.
+ *
+ * Returns true if the configuration is the one of @Geometry.
+ */
+template <class Geometry>
+bool matchesProfile(SimulatorOptions& options) {
+    Geometry geometry{0, 0, 0};
+
+    return options.page_ == geometry.pageSize() &&
+           options.memory_ / options.page_ == geometry.frameCount() &&
+           options.disk_ == geometry.diskCount();
+}
+
+/**
+ * @os: the operating system that gets the group.
+ * @spec: "raid0:<disk>,<disk>,..." or "raid1:<disk>,<disk>,...".
+ *
+ * Returns false if @spec is not a valid disk group.
+ */
+template <class OS>
+bool addDiskGroup(OS& os, string spec) {
+    size_t colon = spec.find(':');
+    if (colon == string::npos) { return false; }
+
+    string level = spec.substr(0, colon);
+    if (level != "raid0" && level != "raid1") { return false; }
+
+    vector<int> members;
+    stringstream list(spec.substr(colon + 1));
+    string member;
+
+    while (getline(list, member, ',')) {
+        if (member.empty() || !isNumber(member)) { return false; }
+        members.push_back(stoi(member));
+    }
+
+    return os.addDiskGroup(level == "raid0" ? RAID_0 : RAID_1, members) >= 0;
+}
+
+/**
+ * @os: the operating system the trace starts from.
+ * @options: the configuration that was entered, with --record or --replay.
+ *
+ * Reads the trace from the standard input, then records it or replays it
+ * against the record file. Returns 1 if the record cannot be used or the
+ * replay fails.
+ */
+template <class OS>
+int runTrace(OS& os, SimulatorOptions& options) {
+    vector<string> commands;
+    string line;
+
+    while (getline(cin, line)) {
+        commands.push_back(line);
+    }
+
+    TraceReplayer<OS> replayer{os, commands};
+    ReplayRecord record;
+
+    if (!options.record_path_.empty()) {
+        if (!replayer.record(options.checkpoint_interval_, record)) {
+            cout << "Cannot record a trace with a backing store or a swap area" << endl;
+            return 1;
+        } else if (!record.save(options.record_path_)) {
+            cout << "Could not write " << options.record_path_ << endl;
+            return 1;
+        }
+
+        cout << "Recorded " << record.commands_ << " commands, " << record.checkpoints_.size();
+        cout << " checkpoints, " << (long) record.throughput_ << " commands/sec" << endl;
+        return 0;
+    }
+
+    if (!record.load(options.replay_path_)) {
+        cout << "Could not read the record " << options.replay_path_ << endl;
+        return 1;
+    }
+
+    return replayer.verify(record, options.max_regression_, cout) ? 0 : 1;
+}
+
+/**
+ * @options: the configuration that was entered.
+ *
+ * Builds the operating system and its optional backing store and swap area,
+ * then either records or replays a trace, serves it on a socket or runs the
+ * interactive prompt.
+ */
+template <class Geometry>
+int runSimulator(SimulatorOptions& options) {
+    string user_input;
+
+    BasicOperatingSystem<Geometry> os{options.memory_, options.page_, options.disk_};
+    if (options.max_pid_ > 0) { os.setMaxPid(options.max_pid_); }
+    os.configureNuma(options.numa_);
+    os.setPrefetchLimit(options.prefetch_);
+    os.setQuantum(options.quantum_, options.quantum_unit_);
+    os.configureQuotas(options.quota_);
+    os.configureBufferCache(options.cache_blocks_, options.cache_policy_);
 
-    while (true) {
+    int writeback_disk = options.disk_ > 0 ? options.writeback_disk_ : -1;
+    if (!os.configureWriteBack(writeback_disk, options.writeback_batch_, options.dirty_ratio_)) {
+        cout << "Invalid write-back disk " << writeback_disk << " or batch ";
+        cout << options.writeback_batch_ << endl;
+        return 1;
+    }
+
+    for (auto &spec : options.disk_groups_) {
+        if (!addDiskGroup(os, spec)) {
+            cout << "Invalid disk group " << spec << endl;
+            return 1;
+        }
+    }
+    BackingStore* backing_store = nullptr;
+
+    if (!options.backing_dir_.empty()) {
+        backing_store = new BackingStore(options.backing_dir_, options.disk_,
+                                         options.io_size_, options.io_workers_);
+        os.attachBackingStore(backing_store);
+    }
+
+    SwapArea* swap = nullptr;
+
+    if (!options.swap_file_.empty()) {
+        swap = new SwapArea(options.swap_file_, options.swap_slots_,
+                            options.swap_in_us_, options.swap_out_us_);
+
+        if (!swap->isReady()) {
+            cout << "Could not create swap file " << options.swap_file_ << endl;
+            delete swap;
+            delete backing_store;
+            return 1;
+        }
+        os.attachSwap(swap);
+    }
+
+    int result = 0;
+
+    if (!options.record_path_.empty() || !options.replay_path_.empty()) {
+        result = runTrace(os, options);
+    } else if (!options.socket_path_.empty()) {
+        SimulatorServer<BasicOperatingSystem<Geometry> > server{os, options.socket_path_};
+
+        if (server.start()) {
+            server.run();
+        } else {
+            result = 1;
+        }
+    } else {
+        CommandInterpreter<BasicOperatingSystem<Geometry> > interpreter{os};
+
+        interpreter.help();
+
+        while (true) {
+            cout << "> ";
+            if (!getline(cin, user_input)) { break; }
+            os.pollDiskCompletions();
+
+            if (interpreter.execute(user_input) == COMMAND_SHUTDOWN) { break; }
+        }
+    }
+
+    delete backing_store;
+    delete swap;
+
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    SimulatorOptions options;
+    bool configured{false};
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+
+        if (option == "--memory" && isNumber(argv[i + 1])) {
+            options.memory_ = stol(argv[i + 1]);
+        } else if (option == "--page-size" && isNumber(argv[i + 1])) {
+            options.page_ = stoi(argv[i + 1]);
+        } else if (option == "--disks" && isNumber(argv[i + 1])) {
+            options.disk_ = stoi(argv[i + 1]);
+        } else if (option == "--serve") {
+            options.socket_path_ = argv[i + 1];
+        } else if (option == "--backing-dir") {
+            options.backing_dir_ = argv[i + 1];
+        } else if (option == "--io-size" && isNumber(argv[i + 1])) {
+            options.io_size_ = stol(argv[i + 1]);
+        } else if (option == "--io-workers" && isNumber(argv[i + 1])) {
+            options.io_workers_ = stoi(argv[i + 1]);
+        } else if (option == "--swap-file") {
+            options.swap_file_ = argv[i + 1];
+        } else if (option == "--swap-slots" && isNumber(argv[i + 1])) {
+            options.swap_slots_ = stoi(argv[i + 1]);
+        } else if (option == "--swap-in-us" && isNumber(argv[i + 1])) {
+            options.swap_in_us_ = stoi(argv[i + 1]);
+        } else if (option == "--swap-out-us" && isNumber(argv[i + 1])) {
+            options.swap_out_us_ = stoi(argv[i + 1]);
+        } else if (option == "--numa-nodes" && isNumber(argv[i + 1])) {
+            options.numa_.node_count_ = stoi(argv[i + 1]);
+        } else if (option == "--numa-policy" && (string(argv[i + 1]) == "first-touch" ||
+                                                 string(argv[i + 1]) == "interleave")) {
+            options.numa_.policy_ = string(argv[i + 1]) == "interleave" ? NUMA_INTERLEAVE : NUMA_FIRST_TOUCH;
+        } else if (option == "--numa-local-ns" && isNumber(argv[i + 1])) {
+            options.numa_.local_ns_ = stoi(argv[i + 1]);
+        } else if (option == "--numa-remote-ns" && isNumber(argv[i + 1])) {
+            options.numa_.remote_ns_ = stoi(argv[i + 1]);
+        } else if (option == "--numa-migrate" && isNumber(argv[i + 1])) {
+            options.numa_.migrate_after_ = stoi(argv[i + 1]);
+        } else if (option == "--disk-group") {
+            options.disk_groups_.push_back(argv[i + 1]);
+        } else if (option == "--prefetch" && isNumber(argv[i + 1])) {
+            options.prefetch_ = stoi(argv[i + 1]);
+        } else if (option == "--max-pid" && isNumber(argv[i + 1])) {
+            options.max_pid_ = stoi(argv[i + 1]);
+        } else if (option == "--writeback-disk" && (isNumber(argv[i + 1]) || string(argv[i + 1]) == "off")) {
+            options.writeback_disk_ = string(argv[i + 1]) == "off" ? -1 : stoi(argv[i + 1]);
+        } else if (option == "--writeback-batch" && isNumber(argv[i + 1])) {
+            options.writeback_batch_ = stoi(argv[i + 1]);
+        } else if (option == "--dirty-ratio" && isNumber(argv[i + 1])) {
+            options.dirty_ratio_ = stoi(argv[i + 1]);
+        } else if (option == "--buffer-cache" && isNumber(argv[i + 1])) {
+            options.cache_blocks_ = stoi(argv[i + 1]);
+        } else if (option == "--cache-policy" && (string(argv[i + 1]) == "lru" ||
+                                                  string(argv[i + 1]) == "2q")) {
+            options.cache_policy_ = string(argv[i + 1]) == "2q" ? CACHE_2Q : CACHE_LRU;
+        } else if (option == "--quantum" && isNumber(argv[i + 1])) {
+            options.quantum_ = stol(argv[i + 1]);
+        } else if (option == "--quantum-unit" && (string(argv[i + 1]) == "ticks" ||
+                                                  string(argv[i + 1]) == "refs")) {
+            options.quantum_unit_ = string(argv[i + 1]) == "refs" ? QUANTUM_REFERENCES : QUANTUM_TICKS;
+        } else if (option == "--quota" && (string(argv[i + 1]) == "off" ||
+                                           string(argv[i + 1]) == "proportional" ||
+                                           string(argv[i + 1]) == "priority")) {
+            string policy = argv[i + 1];
+            options.quota_.policy_ = policy == "priority" ? QUOTA_PRIORITY :
+                                     policy == "proportional" ? QUOTA_PROPORTIONAL : QUOTA_OFF;
+        } else if (option == "--replacement" && (string(argv[i + 1]) == "global" ||
+                                                 string(argv[i + 1]) == "local")) {
+            options.quota_.scope_ = string(argv[i + 1]) == "local" ? SCOPE_LOCAL : SCOPE_GLOBAL;
+        } else if (option == "--profiles") {
+            options.use_profiles_ = string(argv[i + 1]) != "off";
+        } else if (option == "--record") {
+            options.record_path_ = argv[i + 1];
+        } else if (option == "--replay") {
+            options.replay_path_ = argv[i + 1];
+        } else if (option == "--max-regression" && isNumber(argv[i + 1])) {
+            options.max_regression_ = stoi(argv[i + 1]);
+        } else if (option == "--checkpoint-every" && isNumber(argv[i + 1])) {
+            options.checkpoint_interval_ = stoi(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+
+    if (options.io_size_ < 1) {
+        cout << "--io-size must be at least 1 byte" << endl;
+        return 1;
+    }
+
+    if (options.memory_ > 0 && options.page_ > 0 && options.disk_ > 0) {
+        configured = true;
+    } else if (!options.socket_path_.empty()) {
+        cout << "Server mode needs --memory, --page-size and --disks" << endl;
+        return 1;
+    } else if (!options.record_path_.empty() || !options.replay_path_.empty()) {
+        cout << "Record and replay need --memory, --page-size and --disks" << endl;
+        return 1;
+    }
+
+    while (!configured) {
         cout << "Enter Memory Amount: ";
-        cin >> memory_;
+        cin >> options.memory_;
 
         cout << "Enter Page Size: ";
-        cin >> page_;
+        cin >> options.page_;
 
         cout << "Enter Number of Disks: ";
-        cin >> disk_;
+        cin >> options.disk_;
 
         break;
     }
-    string user_input, first, second, third;
-
-    OperatingSystem os{memory_, page_, disk_};
-
-    os.help();
-
-    while (first != "bsod") {
-        cout << "> ";
-        getline(cin, user_input);
-
-        stringstream s(user_input), stream; 
-        s >> first;
-
-        if (first == "A") {
-            os.spawnProcess();
-        } else if (first == "Q") {
-            os.preemptProcess();
-        } else if (first == "fork") {
-            os.forkProcess();
-        } else if (first == "exit") {
-            os.exitProcess();
-        } else if (first == "wait") {
-            os.waitProcess();
-        } else if (first == "S") {
-            s >> second;
-            if (second == "i") {
-                os.snapshotIO();
-            } else if (second == "m") {
-                os.snapshotMemory();
-            } else if (second == "r") {
-                os.snapshotCPU();
-            } else {
-                cout << "Invalid command" << endl;
-            }
-        } else if (first == "d") {
-            s >> second;
-
-            if (isNumber(second)) {
-                stream << second;
-                int disk_num;
-
-                stream >> disk_num;
-                s >> third;
-
-                os.useDisk(disk_num, third);
-            } else {
-                cout << "Invalid command" << endl;
-            }
-        } else if (first == "D") {
-            s >> second;
-
-            if (isNumber(second)) {
-                stream << second;
-                int disk_num;
-                
-                stream >> disk_num;
-
-                os.finishDiskUsage(disk_num);
-            } else {
-                cout << "Invalid command" << endl;
-            }
-        } else if (first == "m") {
-            s >> second; 
-
-            if (isNumber(second)) {
-                stream << second;
-                int mem_address;
-
-                stream >> mem_address;
-
-                os.useMemory(mem_address);
-            } else if (first == "help") {
-                os.help();
-            } else {
-                cout << "Invalid command" << endl;
-            }
+
+    if (options.use_profiles_ && options.page_ > 0) {
+        if (matchesProfile<SmallProfile>(options)) {
+            return runSimulator<SmallProfile>(options);
+        } else if (matchesProfile<MediumProfile>(options)) {
+            return runSimulator<MediumProfile>(options);
+        } else if (matchesProfile<LargeProfile>(options)) {
+            return runSimulator<LargeProfile>(options);
         }
     }
-}
\ No newline at end of file
+
+    return runSimulator<RuntimeGeometry>(options);
+}
@@ -0,0 +1,352 @@
+/**
+ * Header file for the SwapArea class that simulates the swap device. Pages
+ * evicted from the MemoryTable are written to a slot of a memory-mapped file
+ * so that a later reference to the page is a major fault.
+ */
+
+#ifndef SWAP_AREA_H
+#define SWAP_AREA_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Struct that is stored in every slot of the swap file. Free slots are chained
+ * through @next_ and used slots are chained per process through @prev_ and @next_
+ * so all of the bookkeeping lives in the file itself.
+ */
+struct SwapSlot {
+    int process_id_;
+    int page_num_;
+    int prev_;
+    int next_;
+};
+
+/**
+ * Struct that holds the counters reported by the 'S s' command.
+ */
+struct SwapStats {
+    long swap_outs_;
+    long swap_ins_;
+    long dropped_;
+    long used_slots_;
+    long capacity_;
+    long swap_time_us_;
+
+    SwapStats() :
+        swap_outs_{0}, swap_ins_{0}, dropped_{0}, used_slots_{0}, capacity_{0},
+        swap_time_us_{0}
+        { }
+};
+
+class SwapArea {
+    public:
+        /**
+         * @path: file that will back the swap area.
+         * @capacity: number of page slots in the swap area.
+         * @swap_in_us: modeled latency of reading one page back in.
+         * @swap_out_us: modeled latency of writing one page out.
+         *
+         * Sizes the file and maps it into memory. The file is sparse so only the
+         * slots that are actually used take up space.
+         */
+        SwapArea(string path, int capacity, int swap_in_us, int swap_out_us) :
+            slots_{nullptr}, capacity_{capacity}, high_water_{0}, free_head_{-1},
+            index_size_{0}, swap_in_us_{swap_in_us}, swap_out_us_{swap_out_us}
+            {
+                fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+                if (fd_ >= 0 && ftruncate(fd_, (off_t) capacity_ * sizeof(SwapSlot)) == 0) {
+                    void* mapped = mmap(nullptr, (size_t) capacity_ * sizeof(SwapSlot),
+                                        PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+                    if (mapped != MAP_FAILED) {
+                        slots_ = static_cast<SwapSlot*>(mapped);
+                    }
+                }
+
+                if (slots_ == nullptr) { capacity_ = 0; }
+
+                stats_.capacity_ = capacity_;
+                resizeIndex(16);
+            }
+
+        /**
+         * Unmaps and closes the swap file.
+         */
+        ~SwapArea() {
+            if (slots_ != nullptr) { munmap(slots_, (size_t) capacity_ * sizeof(SwapSlot)); }
+            if (fd_ >= 0) { close(fd_); }
+        }
+
+        /**
+         * Returns false if the swap file could not be created or mapped.
+         */
+        bool isReady() {
+            return slots_ != nullptr;
+        }
+
+        /**
+         * @pid: owner of the evicted page.
+         * @page_num: the evicted page.
+         *
+         * Writes the page to a free slot. If the swap area is full the page is
+         * dropped and counted in @dropped_.
+         */
+        void swapOut(int pid, int page_num) {
+            if (findSlot(pid, page_num) >= 0) { return; }
+
+            int slot = allocateSlot();
+            if (slot < 0) {
+                stats_.dropped_++;
+                return;
+            }
+
+            slots_[slot].process_id_ = pid;
+            slots_[slot].page_num_ = page_num;
+            linkToProcess(slot);
+            insertIndex(makeKey(pid, page_num), slot);
+
+            stats_.swap_outs_++;
+            stats_.used_slots_++;
+            stats_.swap_time_us_ += swap_out_us_;
+        }
+
+        /**
+         * @pid: process that referenced the page.
+         * @page_num: page that was referenced.
+         *
+         * If the page is on the swap area it is read back in and its slot freed.
+         * Returns true in that case (a major fault), false otherwise.
+         */
+        bool swapIn(int pid, int page_num) {
+            int slot = findSlot(pid, page_num);
+            if (slot < 0) { return false; }
+
+            eraseIndex(makeKey(pid, page_num));
+            unlinkFromProcess(slot);
+            freeSlot(slot);
+
+            stats_.swap_ins_++;
+            stats_.used_slots_--;
+            stats_.swap_time_us_ += swap_in_us_;
+
+            return true;
+        }
+
+        /**
+         * @pid: the process whose swapped pages are discarded.
+         *
+         * Walks the process's chain of slots and frees every one of them.
+         */
+        void releaseResources(int pid) {
+            unordered_map<int, int>::iterator head = process_heads_.find(pid);
+            if (head == process_heads_.end()) { return; }
+
+            int slot = head->second;
+            while (slot >= 0) {
+                int next = slots_[slot].next_;
+
+                eraseIndex(makeKey(pid, slots_[slot].page_num_));
+                freeSlot(slot);
+                stats_.used_slots_--;
+
+                slot = next;
+            }
+
+            process_heads_.erase(head);
+        }
+
+        /**
+         * Returns a copy of the swap statistics.
+         */
+        SwapStats getStats() {
+            return stats_;
+        }
+
+    private:
+        /**
+         * @fd_: the swap file.
+         * @slots_: the mapped slots of the swap file.
+         * @capacity_: the number of slots.
+         * @high_water_: slots below this index have been used at least once.
+         * @free_head_: first slot of the free list, -1 if empty.
+         * @index_keys_: open addressing table of (pid, page) keys, -1 if empty.
+         * @index_slots_: slot stored for the key at the same position.
+         * @index_size_: number of keys in the table.
+         * @process_heads_: first slot of each process's chain.
+         * @swap_in_us_: modeled cost of a swap in.
+         * @swap_out_us_: modeled cost of a swap out.
+         * @stats_: counters reported to the user.
+         */
+        int fd_;
+        SwapSlot* slots_;
+        int capacity_;
+        int high_water_;
+        int free_head_;
+        vector<long long> index_keys_;
+        vector<int> index_slots_;
+        long index_size_;
+        unordered_map<int, int> process_heads_;
+        int swap_in_us_;
+        int swap_out_us_;
+        SwapStats stats_;
+
+        static long long makeKey(int pid, int page_num) {
+            return ((long long) pid << 32) | (unsigned int) page_num;
+        }
+
+        /**
+         * @key: key whose home position in the index is returned.
+         */
+        size_t homeOf(long long key) {
+            unsigned long long hash = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+            return (size_t) (hash >> 17) & (index_keys_.size() - 1);
+        }
+
+        /**
+         * Pops a slot from the free list, or takes a never used slot.
+         * Returns -1 if the swap area is full.
+         */
+        int allocateSlot() {
+            if (free_head_ >= 0) {
+                int slot = free_head_;
+                free_head_ = slots_[slot].next_;
+                return slot;
+            }
+
+            if (high_water_ < capacity_) {
+                return high_water_++;
+            }
+
+            return -1;
+        }
+
+        void freeSlot(int slot) {
+            slots_[slot].next_ = free_head_;
+            free_head_ = slot;
+        }
+
+        /**
+         * @slot: slot pushed to the front of its owner's chain.
+         */
+        void linkToProcess(int slot) {
+            int pid = slots_[slot].process_id_;
+            unordered_map<int, int>::iterator head = process_heads_.find(pid);
+
+            slots_[slot].prev_ = -1;
+            slots_[slot].next_ = -1;
+
+            if (head == process_heads_.end()) {
+                process_heads_[pid] = slot;
+            } else {
+                slots_[slot].next_ = head->second;
+                slots_[head->second].prev_ = slot;
+                head->second = slot;
+            }
+        }
+
+        /**
+         * @slot: slot removed from its owner's chain.
+         */
+        void unlinkFromProcess(int slot) {
+            int pid = slots_[slot].process_id_;
+            int prev = slots_[slot].prev_;
+            int next = slots_[slot].next_;
+
+            if (next >= 0) { slots_[next].prev_ = prev; }
+
+            if (prev >= 0) {
+                slots_[prev].next_ = next;
+            } else if (next >= 0) {
+                process_heads_[pid] = next;
+            } else {
+                process_heads_.erase(pid);
+            }
+        }
+
+        /**
+         * Returns the slot holding (@pid, @page_num) or -1.
+         */
+        int findSlot(int pid, int page_num) {
+            long long key = makeKey(pid, page_num);
+            size_t mask = index_keys_.size() - 1;
+
+            for (size_t i = homeOf(key); index_keys_[i] != -1; i = (i + 1) & mask) {
+                if (index_keys_[i] == key) {
+                    return index_slots_[i];
+                }
+            }
+
+            return -1;
+        }
+
+        void insertIndex(long long key, int slot) {
+            if ((index_size_ + 1) * 2 > (long) index_keys_.size()) {
+                resizeIndex(index_keys_.size() * 2);
+            }
+
+            size_t mask = index_keys_.size() - 1;
+            size_t i = homeOf(key);
+            while (index_keys_[i] != -1) { i = (i + 1) & mask; }
+
+            index_keys_[i] = key;
+            index_slots_[i] = slot;
+            index_size_++;
+        }
+
+        /**
+         * @key: key removed from the index.
+         *
+         * Linear probing deletion that shifts the following entries back so no
+         * tombstones are ever needed.
+         */
+        void eraseIndex(long long key) {
+            size_t mask = index_keys_.size() - 1;
+            size_t i = homeOf(key);
+
+            while (index_keys_[i] != key) {
+                if (index_keys_[i] == -1) { return; }
+                i = (i + 1) & mask;
+            }
+
+            size_t hole = i;
+            for (size_t j = (hole + 1) & mask; index_keys_[j] != -1; j = (j + 1) & mask) {
+                size_t home = homeOf(index_keys_[j]);
+
+                if (((j - home) & mask) >= ((j - hole) & mask)) {
+                    index_keys_[hole] = index_keys_[j];
+                    index_slots_[hole] = index_slots_[j];
+                    hole = j;
+                }
+            }
+
+            index_keys_[hole] = -1;
+            index_size_--;
+        }
+
+        void resizeIndex(size_t size) {
+            vector<long long> old_keys;
+            vector<int> old_slots;
+            old_keys.swap(index_keys_);
+            old_slots.swap(index_slots_);
+
+            index_keys_.assign(size, -1);
+            index_slots_.assign(size, -1);
+            index_size_ = 0;
+
+            for (size_t i = 0; i < old_keys.size(); i++) {
+                if (old_keys[i] != -1) {
+                    insertIndex(old_keys[i], old_slots[i]);
+                }
+            }
+        }
+};
+
+#endif